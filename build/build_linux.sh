@@ -1,13 +1,14 @@
 #!/bin/bash
 
 CXX=${CXX:-clang++}
+EXTRA_FLAGS=${EXTRA_FLAGS:-} # e.g. EXTRA_FLAGS="-DMAX_PLY=128"
 
 build_sse3() {
     echo "Building SSE3 version..."
     rm -f sloth_sse3
     $CXX -o sloth ../src/glob.cpp -Ofast -flto -ftree-vectorize -funroll-loops -w \
         -static -DNDEBUG -finline-functions -pipe -std=c++23 -ffast-math -fno-rtti \
-        -fstrict-aliasing -fomit-frame-pointer -fuse-ld=lld \
+        -fstrict-aliasing -fomit-frame-pointer -fuse-ld=lld -pthread $EXTRA_FLAGS \
         -msse3 -mssse3 -march=sandybridge -mtune=sandybridge
     mv sloth sloth_sse3
 }
@@ -17,7 +18,7 @@ build_sse4() {
     rm -f sloth_sse4
     $CXX -o sloth ../src/glob.cpp -Ofast -flto -ftree-vectorize -funroll-loops -w \
         -static -DNDEBUG -finline-functions -pipe -std=c++23 -ffast-math -fno-rtti \
-        -fstrict-aliasing -fomit-frame-pointer -fuse-ld=lld \
+        -fstrict-aliasing -fomit-frame-pointer -fuse-ld=lld -pthread $EXTRA_FLAGS \
         -msse4.1 -msse4.2 -march=nehalem -mtune=nehalem
     mv sloth sloth_sse4
 }
@@ -27,7 +28,7 @@ build_bmi2() {
     rm -f sloth_bmi2
     $CXX -o sloth ../src/glob.cpp -Ofast -flto -ftree-vectorize -funroll-loops -w \
         -static -DNDEBUG -finline-functions -pipe -std=c++23 -ffast-math -fno-rtti \
-        -fstrict-aliasing -fomit-frame-pointer -fuse-ld=lld \
+        -fstrict-aliasing -fomit-frame-pointer -fuse-ld=lld -pthread $EXTRA_FLAGS \
         -march=haswell -msse4.1 -msse4.2 -mbmi -mfma -mavx2 -mbmi2 -mavx
     mv sloth sloth_bmi2
 }
@@ -37,7 +38,7 @@ build_avx2() {
     rm -f sloth_avx2
     $CXX -o sloth ../src/glob.cpp -Ofast -flto -ftree-vectorize -funroll-loops -w \
         -static -DNDEBUG -finline-functions -pipe -std=c++23 -ffast-math -fno-rtti \
-        -fstrict-aliasing -fomit-frame-pointer -fuse-ld=lld \
+        -fstrict-aliasing -fomit-frame-pointer -fuse-ld=lld -pthread $EXTRA_FLAGS \
         -mavx2 -march=haswell -mtune=haswell
     mv sloth sloth_avx2
 }
@@ -47,11 +48,18 @@ build_avx512() {
     rm -f sloth_avx512
     $CXX -o sloth ../src/glob.cpp -Ofast -flto -ftree-vectorize -funroll-loops -w \
         -static -DNDEBUG -finline-functions -pipe -std=c++23 -ffast-math -fno-rtti \
-        -fstrict-aliasing -fomit-frame-pointer -fuse-ld=lld \
+        -fstrict-aliasing -fomit-frame-pointer -fuse-ld=lld -pthread $EXTRA_FLAGS \
         -mavx512f -mavx512cd -mavx512bw -mavx512dq -march=skylake-avx512 -mtune=skylake-avx512
     mv sloth sloth_avx512
 }
 
+build_microbench() {
+    echo "Building microbenchmarks..."
+    rm -f sloth_microbench
+    $CXX -o sloth_microbench ../src/microbench.cpp -O3 -w -DNDEBUG -pipe -std=c++23 -fno-rtti \
+        -fstrict-aliasing -march=native -mtune=native $EXTRA_FLAGS
+}
+
 if [ -z "$1" ]; then
     build_sse3
     build_sse4
@@ -75,8 +83,11 @@ else
     AVX512|avx512)
         build_avx512
         ;;
+    MICROBENCH|microbench)
+        build_microbench
+        ;;
     *)
-        echo "Invalid argument. Use SSE3, SSE4, BMI2, AVX2, AVX512, or no argument for all."
+        echo "Invalid argument. Use SSE3, SSE4, BMI2, AVX2, AVX512, MICROBENCH, or no argument for all."
         exit 1
         ;;
     esac
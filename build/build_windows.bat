@@ -7,7 +7,8 @@ if /I "%1"=="SSE4" goto sse4
 if /I "%1"=="BMI2" goto bmi2
 if /I "%1"=="AVX2" goto avx2
 if /I "%1"=="AVX512" goto avx512
-echo Invalid argument. Use SSE3, SSE4, BMI2, AVX2, AVX512, or no argument for all.
+if /I "%1"=="MICROBENCH" goto microbench
+echo Invalid argument. Use SSE3, SSE4, BMI2, AVX2, AVX512, MICROBENCH, or no argument for all.
 goto end
 
 :sse3
@@ -35,6 +36,11 @@ if exist "sloth_avx512.exe" del "sloth_avx512.exe"
 call :build_avx512
 goto end
 
+:microbench
+if exist "sloth_microbench.exe" del "sloth_microbench.exe"
+call :build_microbench
+goto end
+
 :all
 call :build_sse3
 call :build_sse4
@@ -83,6 +89,11 @@ echo Building AVX512 version...
 rename sloth sloth_avx512.exe
 goto :eof
 
+:build_microbench
+echo Building microbenchmarks...
+%CXX% -o sloth_microbench.exe ../src/microbench.cpp -O3 -w -DNDEBUG -pipe -std=c++23 -fno-rtti -fstrict-aliasing -march=native -mtune=native
+goto :eof
+
 :end
 echo Build process completed
 exit
\ No newline at end of file
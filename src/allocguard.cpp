@@ -0,0 +1,69 @@
+#include "allocguard.h"
+
+#ifdef ALLOC_GUARD
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace Sloth {
+	enum GuardState { guardOff, guardCounting, guardForbidden };
+
+	static std::atomic<int> guardState(guardOff);
+	static std::atomic<unsigned long long> guardedAllocations(0);
+	static int stateBeforeSearch = guardOff; // bench searches without a go around them
+
+	static void onAllocation(std::size_t size) {
+		int state = guardState.load(std::memory_order_relaxed);
+
+		if (state == guardOff) return;
+
+		if (state == guardForbidden) {
+			// stderr is unbuffered, reporting this does not allocate again
+			fprintf(stderr, "info string allocation guard: %zu bytes allocated during the search\n", size);
+			abort();
+		}
+
+		guardedAllocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void AllocGuard::beginGo() {
+		guardedAllocations = 0;
+		guardState = guardCounting;
+	}
+
+	void AllocGuard::endGo() {
+		guardState = guardOff;
+		printf("info string allocations during go %llu\n", guardedAllocations.load());
+	}
+
+	void AllocGuard::beginSearch() {
+		stateBeforeSearch = guardState;
+		guardState = guardForbidden;
+	}
+
+	void AllocGuard::endSearch() {
+		guardState = stateBeforeSearch;
+	}
+}
+
+void* operator new(std::size_t size) {
+	Sloth::onAllocation(size);
+
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+#endif
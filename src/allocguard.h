@@ -0,0 +1,26 @@
+#pragma once
+
+/*
+	Allocation guard, for builds with ALLOC_GUARD defined (-DALLOC_GUARD).
+
+	The global operator new is replaced by one that counts every allocation made while a go command runs.
+	Setting up a go (parsing searchmoves, growing the repetition table, filling the root moves) may allocate,
+	the count is reported as an info string when the go ends. Once the search itself has started nothing may
+	allocate anymore, an allocation there prints its size and aborts the engine.
+	Without the flag the calls below are empty.
+*/
+namespace Sloth {
+	namespace AllocGuard {
+#ifdef ALLOC_GUARD
+		void beginGo();
+		void endGo();
+		void beginSearch();
+		void endSearch();
+#else
+		inline void beginGo() {}
+		inline void endGo() {}
+		inline void beginSearch() {}
+		inline void endSearch() {}
+#endif
+	}
+}
@@ -0,0 +1,222 @@
+#include "bench.h"
+#include "search.h"
+#include "uci.h"
+#include "profile.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace Sloth {
+	/*
+		Bench positions, shared by the bench command and the microbenchmarks.
+		A fixed depth search over these gives a node count that only changes when the search does,
+		so it doubles as a signature when comparing search changes.
+	*/
+	const char* Bench::fens[] = {
+		startPosition,
+		trickyPosition,
+		killerPosition,
+		"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+		"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+		"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+		"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+		"r1bqkb1r/pp3ppp/2n1pn2/2pp4/3P4/2PBPN2/PP1N1PPP/R1BQK2R b KQkq - 1 6",
+		"2rq1rk1/pp1bbppp/2n1pn2/3p4/3P4/P1NBPN2/1PQ2PPP/R1B2RK1 w - - 3 12",
+		"r2q1rk1/1b2bppp/p2p1n2/1p1Pp3/4P3/1BN2N2/PP3PPP/R2QR1K1 w - - 0 14",
+		"6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+		"8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1",
+		"8/5pk1/6p1/7p/7P/6P1/5PK1/3r4 b - - 0 40",
+		"4r1k1/1q3ppp/p7/1p1Q4/8/1P5P/P4PP1/3R2K1 w - - 0 30",
+	};
+
+	const int Bench::fenCount = sizeof(Bench::fens) / sizeof(Bench::fens[0]);
+
+	/*
+		Hardware counters, read through perf_event_open on Linux. Every counter is opened on its own, so a CPU
+		without one of the events still reports the rest. The kernel multiplexes them when there are more events
+		than counter registers, the values are scaled up by the share of the time each one was running.
+		Containers and perf_event_paranoid > 2 usually refuse them all, the bench then says so and carries on.
+	*/
+	enum HardwareEvent { HW_INSTRUCTIONS, HW_CYCLES, HW_CACHE_MISSES, HW_BRANCH_MISSES, HW_DTLB_MISSES, HW_EVENT_NB };
+
+	struct HardwareCounters {
+		int fds[HW_EVENT_NB];
+		int error; // errno of the first event that could not be opened
+		double values[HW_EVENT_NB];
+		bool counted[HW_EVENT_NB];
+	};
+
+#ifdef __linux__
+	static int openCounter(unsigned int type, U64 config) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+	}
+#endif
+
+	static void startCounters(HardwareCounters& counters) {
+		counters.error = 0;
+
+		for (int e = 0; e < HW_EVENT_NB; e++) {
+			counters.fds[e] = -1;
+			counters.counted[e] = false;
+		}
+
+#ifdef __linux__
+		const struct { unsigned int type; U64 config; } events[HW_EVENT_NB] = {
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+			{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+		};
+
+		for (int e = 0; e < HW_EVENT_NB; e++) {
+			counters.fds[e] = openCounter(events[e].type, events[e].config);
+
+			if (counters.fds[e] < 0 && !counters.error) counters.error = errno;
+		}
+
+		for (int e = 0; e < HW_EVENT_NB; e++) {
+			if (counters.fds[e] >= 0) {
+				ioctl(counters.fds[e], PERF_EVENT_IOC_RESET, 0);
+				ioctl(counters.fds[e], PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+#endif
+	}
+
+	static void stopCounters(HardwareCounters& counters) {
+#ifdef __linux__
+		for (int e = 0; e < HW_EVENT_NB; e++) {
+			if (counters.fds[e] < 0) continue;
+
+			ioctl(counters.fds[e], PERF_EVENT_IOC_DISABLE, 0);
+
+			U64 data[3]; // value, time enabled, time running
+
+			if (read(counters.fds[e], data, sizeof(data)) == sizeof(data) && data[2] > 0) {
+				counters.values[e] = static_cast<double>(data[0]) * data[1] / data[2];
+				counters.counted[e] = true;
+			}
+
+			close(counters.fds[e]);
+		}
+#endif
+	}
+
+	// the counters against the node count, events that could not be counted are left out
+	static void printCounters(const HardwareCounters& counters, U64 nodes) {
+		const double* values = counters.values;
+		const bool* counted = counters.counted;
+		bool any = false;
+
+		for (int e = 0; e < HW_EVENT_NB; e++) any |= counted[e];
+
+		if (!any) {
+#ifdef __linux__
+			printf("Hardware counters: unavailable (%s)\n", counters.error ? strerror(counters.error) : "no events counted");
+#else
+			printf("Hardware counters: unavailable on this platform\n");
+#endif
+			return;
+		}
+
+		if (nodes == 0) nodes = 1;
+
+		if (counted[HW_INSTRUCTIONS] && counted[HW_CYCLES] && values[HW_CYCLES] > 0)
+			printf("Instructions per cycle: %.2f\n", values[HW_INSTRUCTIONS] / values[HW_CYCLES]);
+
+		if (counted[HW_CYCLES]) printf("Cycles per node: %.1f\n", values[HW_CYCLES] / nodes);
+		if (counted[HW_CACHE_MISSES]) printf("Cache misses per node: %.3f\n", values[HW_CACHE_MISSES] / nodes);
+		if (counted[HW_BRANCH_MISSES]) printf("Branch misses per node: %.3f\n", values[HW_BRANCH_MISSES] / nodes);
+		if (counted[HW_DTLB_MISSES]) printf("dTLB misses per node: %.3f\n", values[HW_DTLB_MISSES] / nodes);
+	}
+
+	void Bench::run(int depth) {
+		if (depth < 1) depth = 1;
+
+		unsigned long long totalNodes = 0;
+		unsigned long long qsearchNodes = 0, lmrSearches = 0, lmrResearches = 0, aspirationResearches = 0; // SEARCH_STATS builds only
+		long totalTime = 0;
+
+#ifdef PHASE_TIMERS
+		Profile::reset();
+		U64 startCycles = Profile::readCycles();
+#endif
+
+		HardwareCounters hardwareCounters;
+		startCounters(hardwareCounters);
+
+		for (int i = 0; i < fenCount; i++) {
+			printf("\nPosition %d/%d: %s\n", i + 1, fenCount, fens[i]);
+
+			// every position starts from an empty table so the node count is reproducible
+			game.time.ponder = false;
+			Search::clearHashTable();
+
+			char command[300];
+			snprintf(command, sizeof(command), "position fen %s", fens[i]);
+			UCI::parsePosition(game, command);
+
+			game.time.timeSet = 0;
+			game.time.stopTime = 0;
+			game.time.startTime = game.time.getTimeMs();
+
+			Search::searchMoves.clear(); // a searchmoves list left behind by the last go would not fit these positions
+
+			Search::search(game, depth, false);
+
+			totalNodes += Search::stats.nodes;
+
+			SEARCH_STAT(
+				qsearchNodes += Search::stats.qsearchNodes;
+				lmrSearches += Search::stats.lmrSearches;
+				lmrResearches += Search::stats.lmrResearches;
+				aspirationResearches += Search::stats.aspirationResearches;
+			);
+			totalTime += game.time.getTimeMs() - game.time.startTime;
+		}
+
+		stopCounters(hardwareCounters);
+
+		// leave the engine on a sane position, the bench clobbered the board
+		UCI::parsePosition(game, "position startpos");
+		Search::clearHashTable();
+
+		if (totalTime == 0) totalTime = 1;
+
+		printf("\n===========================\n");
+		printf("Depth: %d\n", depth);
+		printf("Total time (ms): %ld\n", totalTime);
+		printf("Nodes searched: %llu\n", totalNodes);
+		printf("Nodes/second: %llu\n", static_cast<unsigned long long>(totalNodes / (totalTime / 1000.0)));
+
+#ifdef SEARCH_STATS
+		printf("Qsearch nodes: %llu (%.2f%%)\n", qsearchNodes, totalNodes ? 100.0 * qsearchNodes / totalNodes : 0.0);
+		printf("LMR re-searches: %llu / %llu (%.2f%%)\n", lmrResearches, lmrSearches, lmrSearches ? 100.0 * lmrResearches / lmrSearches : 0.0);
+		printf("Aspiration re-searches: %llu\n", aspirationResearches);
+#endif
+
+		printCounters(hardwareCounters, totalNodes);
+
+#ifdef PHASE_TIMERS
+		Profile::print(Profile::readCycles() - startCycles);
+#endif
+	}
+}
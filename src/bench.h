@@ -0,0 +1,13 @@
+#pragma once
+
+#include "position.h"
+
+namespace Sloth {
+	namespace Bench {
+		extern const char* fens[];
+		extern const int fenCount;
+
+		// searches every bench position to a fixed depth and prints the totals
+		void run(int depth);
+	}
+}
@@ -27,8 +27,11 @@ namespace Sloth {
 	U64 Bitboards::knightAttacks[64];
 	U64 Bitboards::kingAttacks[64];
 
-	U64 Bitboards::bitboards[12];
-	U64 Bitboards::occupancies[3];
+	U64 Bitboards::betweenMasks[64][64];
+	U64 Bitboards::lineMasks[64][64];
+
+	thread_local U64 Bitboards::bitboards[12];
+	thread_local U64 Bitboards::occupancies[3];
 
 	void Bitboards::printBitboard(U64 bb, bool flip) {
 		if (flip) {
@@ -125,6 +128,26 @@ namespace Sloth {
 		}
 	}
 
+	void Bitboards::initLineMasks() {
+		for (int a = 0; a < 64; a++) {
+			for (int b = 0; b < 64; b++) {
+				betweenMasks[a][b] = lineMasks[a][b] = 0ULL;
+
+				if (a == b) continue;
+
+				U64 bBB = 1ULL << b;
+
+				if (Magic::getBishopAttacks(a, 0ULL) & bBB) {
+					betweenMasks[a][b] = Magic::getBishopAttacks(a, bBB) & Magic::getBishopAttacks(b, 1ULL << a);
+					lineMasks[a][b] = (Magic::getBishopAttacks(a, 0ULL) & Magic::getBishopAttacks(b, 0ULL)) | (1ULL << a) | bBB;
+				} else if (Magic::getRookAttacks(a, 0ULL) & bBB) {
+					betweenMasks[a][b] = Magic::getRookAttacks(a, bBB) & Magic::getRookAttacks(b, 1ULL << a);
+					lineMasks[a][b] = (Magic::getRookAttacks(a, 0ULL) & Magic::getRookAttacks(b, 0ULL)) | (1ULL << a) | bBB;
+				}
+			}
+		}
+	}
+
 	int Bitboards::countBits(U64 bb) {
 		#ifdef _MSC_VER
 		return _mm_popcnt_u64(bb);
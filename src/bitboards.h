@@ -26,9 +26,15 @@ namespace Sloth {
 		extern U64 knightAttacks[64]; // [square]
 		extern U64 kingAttacks[64];
 
+		extern U64 betweenMasks[64][64]; // squares strictly between two squares on a shared line, 0 if they dont share one
+		extern U64 lineMasks[64][64]; // the whole line through two squares, endpoints included, 0 if they dont share one
+
 		// 12 bitboards, each piece and each color
-		extern U64 bitboards[12];
-		extern U64 occupancies[3]; // This will hold every piece on one bitboard. One for every white piece combined, one for black combined and one with every piece of both color on the bitboard
+		// thread local so that worker threads (e.g. threaded perft) can each hold their own board.
+		// They are zero initialized and defined in the executable, so every access is a single %fs relative load
+		// without a TLS lookup call, and the single threaded search does not pay for it.
+		extern thread_local U64 bitboards[12];
+		extern thread_local U64 occupancies[3]; // This will hold every piece on one bitboard. One for every white piece combined, one for black combined and one with every piece of both color on the bitboard
 
 		void printBitboard(U64 bb, bool flip);
 
@@ -40,6 +46,7 @@ namespace Sloth {
 		U64 maskKingAttacks(int square);
 
 		void initLeaperAttacks();
+		void initLineMasks(); // needs the slider attacks, call after Magic::initAttacks
 
 		extern  int countBits(U64 bitboard); // counts every bit available on a bitboard
 
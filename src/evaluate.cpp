@@ -1,12 +1,18 @@
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
 
 #include "evaluate.h"
+#include "bench.h"
+#include "search.h"
 
 #include "bitboards.h"
 #include "piece.h"
 #include "position.h"
 #include "magic.h"
 #include "types.h"
+#include "profile.h"
 
 #define S(x, y) {x, y}
 
@@ -33,6 +39,43 @@ namespace Sloth {
 		int scoreEndgame = 0;
 	};
 
+	/*
+		Evaluation trace
+
+		The terms are templates on Trace. Eval::trace points activeTrace at a breakdown and runs the traced
+		instance, where every term also adds its opening and endgame score for the side it belongs to. The
+		search uses the instance without tracing, TRACE_TERM compiles to nothing there.
+	*/
+	enum TraceTerm {
+		TRACE_MATERIAL,
+		TRACE_PSQT,
+		TRACE_DOUBLED,
+		TRACE_ISOLATED,
+		TRACE_PASSED,
+		TRACE_BACKWARD,
+		TRACE_CONNECTED,
+		TRACE_PAWN_PUSH,
+		TRACE_MINORS,
+		TRACE_ROOKS,
+		TRACE_MOBILITY,
+		TRACE_KING,
+		TRACE_NB
+	};
+
+	struct EvalTrace {
+		PieceScore terms[TRACE_NB][2]; // [term][white, black], each side from its own point of view
+	};
+
+	static EvalTrace* activeTrace = nullptr;
+
+#define TRACE_TERM(term, white, opening, endgame) \
+	do { \
+		if (Trace) { \
+			activeTrace->terms[term][(white) ? 0 : 1].scoreOpening += (opening); \
+			activeTrace->terms[term][(white) ? 0 : 1].scoreEndgame += (endgame); \
+		} \
+	} while (0)
+
 	const int doublePawnPenaltyOpening = -5;
 	const int doublePawnPenaltyEndgame = -10;
 
@@ -243,6 +286,7 @@ namespace Sloth {
 		return ~occ & (color == Colors::white ? (pawns << 8) : (pawns >> 8));
 	}
 
+	template<bool Trace>
 	inline PieceScore evaluatePawns(int piece, int square, int sideToMove, Position& pos) { // piece variable will switch between black and white pawns
 		int doubled = Bitboards::countBits(Bitboards::bitboards[piece] & Eval::fileMasks[square]); // returns the amount of doubled pawns on the board for said piece side
 		PieceScore score = { 0 };
@@ -253,16 +297,19 @@ namespace Sloth {
 
 		score.scoreOpening += POSITIONAL_SCORE[opening][PAWN][white ? square : MIRROR_SCORE[square]];
 		score.scoreEndgame += POSITIONAL_SCORE[endgame][PAWN][white ? square : MIRROR_SCORE[square]];
+		TRACE_TERM(TRACE_PSQT, white, score.scoreOpening, score.scoreEndgame);
 
 		U64 myPawns = Bitboards::bitboards[white ? Piece::P : Piece::p];
 		int ourColor = white ? Colors::white : Colors::black;
 
 		if (doubled > 1) {
 			scorePiece(&score, (doubled - 1) * doublePawnPenaltyOpening, (doubled - 1) * doublePawnPenaltyEndgame); // this line adds penalty to the current piece, one for opening, and one for endgame
+			TRACE_TERM(TRACE_DOUBLED, white, (doubled - 1) * doublePawnPenaltyOpening, (doubled - 1) * doublePawnPenaltyEndgame);
 		}
 
 		if ((Bitboards::bitboards[piece] & Eval::isolatedMasks[square]) == 0) {
 			scorePiece(&score, isolatedPawnPenaltyOpening, isolatedPawnPenaltyEndgame);
+			TRACE_TERM(TRACE_ISOLATED, white, isolatedPawnPenaltyOpening, isolatedPawnPenaltyEndgame);
 		}
 
 		// Passed pawn (~26 elo)
@@ -303,38 +350,46 @@ namespace Sloth {
 			eval.scoreEndgame += flag * 57;
 
 			scorePiece(&score, eval.scoreOpening, eval.scoreEndgame);
+			TRACE_TERM(TRACE_PASSED, white, eval.scoreOpening, eval.scoreEndgame);
 		}
 
 		int mobility = Bitboards::countBits(~Bitboards::occupancies[Colors::both] & Bitboards::pawnAdvance(1ULL << square, 0ULL, white ? Colors::white : Colors::black));
 
 		scorePiece(&score, mobility, mobility * 2);
+		TRACE_TERM(TRACE_PAWN_PUSH, white, mobility, mobility * 2);
 
 		if ((Bitboards::bitboards[piece] & backwardMasks[square]) == 0) {
 			scorePiece(&score, -4, -7);
+			TRACE_TERM(TRACE_BACKWARD, white, -4, -7);
 		}
 
 		if ((Bitboards::bitboards[piece] & connectedMasks[square]) != 0) {
 			scorePiece(&score, 4, 10);
+			TRACE_TERM(TRACE_CONNECTED, white, 4, 10);
 		}
 
 		return score;
 	}
 
+	template<bool Trace>
 	inline PieceScore evaluateKnights(int piece, int square) {
 		PieceScore score = { 0 };
 		bool white = (piece == Piece::N);
 
 		score.scoreOpening += POSITIONAL_SCORE[opening][KNIGHT][white ? square : MIRROR_SCORE[square]];
 		score.scoreEndgame += POSITIONAL_SCORE[endgame][KNIGHT][white ? square : MIRROR_SCORE[square]];
+		TRACE_TERM(TRACE_PSQT, white, score.scoreOpening, score.scoreEndgame);
 
 		// ~40 elo including this but for bishops
 		if (getRank(square) == (white ? 7 : 0)) {
 			scorePiece(&score, -5, -5);
+			TRACE_TERM(TRACE_MINORS, white, -5, -5);
 		}
 
 		return score;
 	}
 
+	template<bool Trace>
 	inline PieceScore evaluateRooks(int piece, int square) {
 		PieceScore score = { 0 };
 		bool white = (piece == Piece::R);
@@ -343,6 +398,7 @@ namespace Sloth {
 
 		score.scoreOpening += POSITIONAL_SCORE[opening][ROOK][white ? square : MIRROR_SCORE[square]];
 		score.scoreEndgame += POSITIONAL_SCORE[endgame][ROOK][white ? square : MIRROR_SCORE[square]];
+		TRACE_TERM(TRACE_PSQT, white, score.scoreOpening, score.scoreEndgame);
 
 		U64 myPawns = Bitboards::bitboards[white ? Piece::P : Piece::p];
 		U64 enemyPawns = Bitboards::bitboards[white ? Piece::p : Piece::P];
@@ -360,6 +416,7 @@ namespace Sloth {
 			bool open = !(enemyPawns & Eval::fileMasks[square]);
 
 			scorePiece(&score, RookFile[open].scoreOpening, RookFile[open].scoreEndgame);
+			TRACE_TERM(TRACE_ROOKS, white, RookFile[open].scoreOpening, RookFile[open].scoreEndgame);
 		}
 
 		// bonus if friendly rooks are doubled
@@ -370,12 +427,14 @@ namespace Sloth {
 		if (Bitboards::countBits(rooksOnFile) >= 2) {
 			if ((occupiedOnFile(square) & ~rooksOnFile) == 0) {
 				scorePiece(&score, doubledRooks * Bitboards::countBits(rooksOnFile), doubledRooksEndgame * Bitboards::countBits(rooksOnFile));
+				TRACE_TERM(TRACE_ROOKS, white, doubledRooks * Bitboards::countBits(rooksOnFile), doubledRooksEndgame * Bitboards::countBits(rooksOnFile));
 			}
 		}
 
 		if (Bitboards::countBits(rooksOnRank) >= 2) {
 			if ((occupiedOnRank(square) & ~rooksOnRank) == 0) {
 				scorePiece(&score, doubledRooks * Bitboards::countBits(rooksOnRank), doubledRooksEndgame * Bitboards::countBits(rooksOnRank));
+				TRACE_TERM(TRACE_ROOKS, white, doubledRooks * Bitboards::countBits(rooksOnRank), doubledRooksEndgame * Bitboards::countBits(rooksOnRank));
 			}
 		}
 
@@ -397,6 +456,7 @@ namespace Sloth {
 		return score;
 	}
 
+	template<bool Trace>
 	inline PieceScore evaluateBishops(int piece, int square) {
 		PieceScore score = { 0 };
 		PieceScore mobility = getPieceMobility(true, square);
@@ -404,21 +464,26 @@ namespace Sloth {
 
 		score.scoreOpening += POSITIONAL_SCORE[opening][BISHOP][white ? square : MIRROR_SCORE[square]];
 		score.scoreEndgame += POSITIONAL_SCORE[endgame][BISHOP][white ? square : MIRROR_SCORE[square]];
+		TRACE_TERM(TRACE_PSQT, white, score.scoreOpening, score.scoreEndgame);
 
 		scorePiece(&score, mobility.scoreOpening, mobility.scoreEndgame);
+		TRACE_TERM(TRACE_MOBILITY, white, mobility.scoreOpening, mobility.scoreEndgame);
 
 		if (testBit(pawnAdvance(Bitboards::bitboards[Piece::P] | Bitboards::bitboards[Piece::p], 0ULL, white ? Colors::black : Colors::white), square)) {
 			scorePiece(&score, 4, 24);
+			TRACE_TERM(TRACE_MINORS, white, 4, 24);
 		}
 
 		// ~40 elo including this but for knights
 		if (getRank(square) == (white ? 7 : 0)) {
 			scorePiece(&score, -5, -5);
+			TRACE_TERM(TRACE_MINORS, white, -5, -5);
 		}
 
 		return score;
 	}
 
+	template<bool Trace>
 	inline PieceScore evaluateQueens(int piece, int square) {
 		PieceScore score = { 0 };
 		PieceScore mobility = getPieceMobility(false, square);
@@ -426,12 +491,15 @@ namespace Sloth {
 
 		score.scoreOpening += POSITIONAL_SCORE[opening][QUEEN][white ? square : MIRROR_SCORE[square]];
 		score.scoreEndgame += POSITIONAL_SCORE[endgame][QUEEN][white ? square : MIRROR_SCORE[square]];
+		TRACE_TERM(TRACE_PSQT, white, score.scoreOpening, score.scoreEndgame);
 
 		scorePiece(&score, mobility.scoreOpening, mobility.scoreEndgame);
+		TRACE_TERM(TRACE_MOBILITY, white, mobility.scoreOpening, mobility.scoreEndgame);
 
 		return score;
 	}
 
+	template<bool Trace>
 	inline PieceScore evaluateKings(int piece, int square) {
 		PieceScore score = { 0 };
 		bool white = (piece == Piece::K);
@@ -439,6 +507,10 @@ namespace Sloth {
 
 		score.scoreOpening += POSITIONAL_SCORE[opening][KING][white ? square : MIRROR_SCORE[square]];
 		score.scoreEndgame += POSITIONAL_SCORE[endgame][KING][white ? square : MIRROR_SCORE[square]];
+		TRACE_TERM(TRACE_PSQT, white, score.scoreOpening, score.scoreEndgame);
+
+		// everything after the square table is king safety
+		TRACE_TERM(TRACE_KING, white, -score.scoreOpening, -score.scoreEndgame);
 
 		int myKingSq = Bitboards::getLs1bIndex(Bitboards::bitboards[white ? Piece::K : Piece::k]);
 		int theirKingSq = Bitboards::getLs1bIndex(Bitboards::bitboards[white ? Piece::k : Piece::K]);
@@ -489,6 +561,7 @@ namespace Sloth {
 		}
 
 		scorePiece(&score, distScore, distScore);
+		TRACE_TERM(TRACE_KING, white, score.scoreOpening, score.scoreEndgame);
 
 		return score;
 	}
@@ -552,8 +625,109 @@ namespace Sloth {
 		return phaseScore < endgameScore;
 	}
 
-	inline int Eval::evaluate(Position& pos) {
+	// material and terms of every piece on one bitboard
+	template<bool Trace>
+	static inline void evaluatePieceType(int bbPiece, Position& pos) {
+		U64 bb = Bitboards::bitboards[bbPiece];
+
+		int piece, square;
+
+		PieceScore P, N, B, R, Q, K, p, n, b, r, q, k;
 
+		while (bb) { // loop over pieces in current bitboard
+			piece = bbPiece;
+
+			square = Bitboards::getLs1bIndex(bb);
+
+			scores.scoreOpening += materialScore[opening][piece];
+			scores.scoreEndgame += materialScore[endgame][piece];
+
+			if (piece != Piece::K && piece != Piece::k) // the kings cancel out
+				TRACE_TERM(TRACE_MATERIAL, piece <= Piece::K, std::abs(materialScore[opening][piece]), std::abs(materialScore[endgame][piece]));
+
+			switch (piece)
+			{
+			case Piece::P:
+				P = evaluatePawns<Trace>(Piece::P, square, pos.sideToMove, pos);
+				scores.scoreOpening += P.scoreOpening;
+				scores.scoreEndgame += P.scoreEndgame;
+
+				break;
+			case Piece::N:
+				N = evaluateKnights<Trace>(Piece::N, square);
+				scores.scoreOpening += N.scoreOpening;
+				scores.scoreEndgame += N.scoreEndgame;
+
+				break;
+			case Piece::B:
+				B = evaluateBishops<Trace>(Piece::B, square);
+				scores.scoreOpening += B.scoreOpening;
+				scores.scoreEndgame += B.scoreEndgame;
+
+				break;
+			case Piece::R:
+				R = evaluateRooks<Trace>(Piece::R, square);
+				scores.scoreOpening += R.scoreOpening;
+				scores.scoreEndgame += R.scoreEndgame;
+
+				break;
+			case Piece::Q:
+				Q = evaluateQueens<Trace>(Piece::Q, square);
+				scores.scoreOpening += Q.scoreOpening;
+				scores.scoreEndgame += Q.scoreEndgame;
+
+				break;
+			case Piece::K:
+				K = evaluateKings<Trace>(Piece::K, square);
+				scores.scoreOpening += K.scoreOpening;
+				scores.scoreEndgame += K.scoreEndgame;
+
+				break;
+
+			case Piece::p:
+				p = evaluatePawns<Trace>(Piece::p, square, pos.sideToMove, pos);
+				scores.scoreOpening -= p.scoreOpening;
+				scores.scoreEndgame -= p.scoreEndgame;
+
+				break;
+			case Piece::n:
+				n = evaluateKnights<Trace>(Piece::n, square);
+				scores.scoreOpening -= n.scoreOpening;
+				scores.scoreEndgame -= n.scoreEndgame;
+
+				break;
+			case Piece::b:
+				b = evaluateBishops<Trace>(Piece::b, square);
+				scores.scoreOpening -= b.scoreOpening;
+				scores.scoreEndgame -= b.scoreEndgame;
+
+				break;
+			case Piece::r:
+				r = evaluateRooks<Trace>(Piece::r, square);
+				scores.scoreOpening -= r.scoreOpening;
+				scores.scoreEndgame -= r.scoreEndgame;
+
+				break;
+			case Piece::q:
+				q = evaluateQueens<Trace>(Piece::q, square);
+				scores.scoreOpening -= q.scoreOpening;
+				scores.scoreEndgame -= q.scoreEndgame;
+
+				break;
+			case Piece::k:
+				k = evaluateKings<Trace>(Piece::k, square);
+				scores.scoreOpening -= k.scoreOpening;
+				scores.scoreEndgame -= k.scoreEndgame;
+
+				break;
+			}
+
+			popBit(bb, square);
+		}
+	}
+
+	template<bool Trace>
+	static inline int evaluatePosition(Position& pos) {
 		scores.score = 0;
 		scores.scoreEndgame = 0;
 		scores.scoreOpening = 0;
@@ -567,108 +741,32 @@ namespace Sloth {
 		else
 			phase.gamePhase = middlegame;
 
-		U64 bb;
-
-		int piece, square;
-
-		PieceScore P, N, B, R, Q, K, p, n, b, r, q, k;
-
 		if (phase.gamePhase == endgame) {
 			if (isDraw(pos)) return 0;
 		}
 
-		for (int bbPiece = Piece::P; bbPiece <= Piece::k; bbPiece++) {
-			bb = Bitboards::bitboards[bbPiece];
-
-			while (bb) { // loop over pieces in current bitboard
-				piece = bbPiece;
-
-				square = Bitboards::getLs1bIndex(bb);
-
-				scores.scoreOpening += materialScore[opening][piece];
-				scores.scoreEndgame += materialScore[endgame][piece];
-
-				switch (piece)
-				{
-				case Piece::P:
-					P = evaluatePawns(Piece::P, square, pos.sideToMove, pos);
-					scores.scoreOpening += P.scoreOpening;
-					scores.scoreEndgame += P.scoreEndgame;
-
-					break;
-				case Piece::N:
-					N = evaluateKnights(Piece::N, square);
-					scores.scoreOpening += N.scoreOpening;
-					scores.scoreEndgame += N.scoreEndgame;
-
-					break;
-				case Piece::B:
-					B = evaluateBishops(Piece::B, square);
-					scores.scoreOpening += B.scoreOpening;
-					scores.scoreEndgame += B.scoreEndgame;
-
-					break;
-				case Piece::R:
-					R = evaluateRooks(Piece::R, square);
-					scores.scoreOpening += R.scoreOpening;
-					scores.scoreEndgame += R.scoreEndgame;
-
-					break;
-				case Piece::Q:
-					Q = evaluateQueens(Piece::Q, square);
-					scores.scoreOpening += Q.scoreOpening;
-					scores.scoreEndgame += Q.scoreEndgame;
-
-					break;
-				case Piece::K:
-					K = evaluateKings(Piece::K, square);
-					scores.scoreOpening += K.scoreOpening;
-					scores.scoreEndgame += K.scoreEndgame;
-
-					break;
-
-				case Piece::p:
-					p = evaluatePawns(Piece::p, square, pos.sideToMove, pos);
-					scores.scoreOpening -= p.scoreOpening;
-					scores.scoreEndgame -= p.scoreEndgame;
-
-					break;
-				case Piece::n:
-					n = evaluateKnights(Piece::n, square);
-					scores.scoreOpening -= n.scoreOpening;
-					scores.scoreEndgame -= n.scoreEndgame;
-
-					break;
-				case Piece::b:
-					b = evaluateBishops(Piece::b, square);
-					scores.scoreOpening -= b.scoreOpening;
-					scores.scoreEndgame -= b.scoreEndgame;
-
-					break;
-				case Piece::r:
-					r = evaluateRooks(Piece::r, square);
-					scores.scoreOpening -= r.scoreOpening;
-					scores.scoreEndgame -= r.scoreEndgame;
-
-					break;
-				case Piece::q:
-					q = evaluateQueens(Piece::q, square);
-					scores.scoreOpening -= q.scoreOpening;
-					scores.scoreEndgame -= q.scoreEndgame;
-
-					break;
-				case Piece::k:
-					k = evaluateKings(Piece::k, square);
-					scores.scoreOpening -= k.scoreOpening;
-					scores.scoreEndgame -= k.scoreEndgame;
-
-					break;
-				}
+		// one timer per group of terms, a timer per piece would cost more than most of the terms it measures
+		{
+			PHASE_TIMER(EvalPawns);
+			evaluatePieceType<Trace>(Piece::P, pos);
+			evaluatePieceType<Trace>(Piece::p, pos);
+		}
 
-				popBit(bb, square);
+		{
+			PHASE_TIMER(EvalPieces);
+
+			for (int bbPiece = Piece::N; bbPiece <= Piece::Q; bbPiece++) {
+				evaluatePieceType<Trace>(bbPiece, pos);
+				evaluatePieceType<Trace>(bbPiece + Piece::p, pos);
 			}
 		}
 
+		{
+			PHASE_TIMER(EvalKings);
+			evaluatePieceType<Trace>(Piece::K, pos);
+			evaluatePieceType<Trace>(Piece::k, pos);
+		}
+
 		if (phase.gamePhase == middlegame) { // interpolating scores in the middlegame
 			/*
 				Formula used for calculating interpolated score for a given game phase:
@@ -688,4 +786,186 @@ namespace Sloth {
 
 		return (pos.sideToMove == Colors::white) ? scores.score : -scores.score;
 	}
-}
\ No newline at end of file
+
+	inline int Eval::evaluate(Position& pos) {
+		PHASE_TIMER(Evaluate);
+
+		return evaluatePosition<false>(pos);
+	}
+
+	static const char* traceTermNames[TRACE_NB] = {
+		"Material",
+		"PSQT",
+		"Doubled pawns",
+		"Isolated pawns",
+		"Passed pawns",
+		"Backward pawns",
+		"Connected pawns",
+		"Pawn pushes",
+		"Minor pieces",
+		"Rooks",
+		"Mobility",
+		"King safety",
+	};
+
+	static void printTraceRow(const char* name, const PieceScore& white, const PieceScore& black) {
+		printf("%-16s | %6d %6d | %6d %6d | %6d %6d\n", name, white.scoreOpening, white.scoreEndgame, black.scoreOpening, black.scoreEndgame,
+			white.scoreOpening - black.scoreOpening, white.scoreEndgame - black.scoreEndgame);
+	}
+
+	/*
+		Term timings. Every function below runs one evaluation term over the whole board the way evaluate does,
+		so their times show what each term costs per evaluation. The sum is below the time of evaluate itself,
+		which also pays for the piece loop and the phase interpolation.
+	*/
+	static int timePhase(Position& pos) {
+		return getGamePhaseScore() + isDraw(pos);
+	}
+
+	template<int White, int Black, typename Term>
+	static int timePieces(Term term) {
+		int sum = 0;
+
+		for (int piece : { White, Black }) {
+			U64 bb = Bitboards::bitboards[piece];
+
+			while (bb) {
+				int square = Bitboards::getLs1bIndex(bb);
+				PieceScore score = term(piece, square);
+
+				sum += score.scoreOpening + score.scoreEndgame;
+				popBit(bb, square);
+			}
+		}
+
+		return sum;
+	}
+
+	static int timePawns(Position& pos) {
+		return timePieces<Piece::P, Piece::p>([&pos](int piece, int square) { return evaluatePawns<false>(piece, square, pos.sideToMove, pos); });
+	}
+
+	static int timeKnights(Position&) {
+		return timePieces<Piece::N, Piece::n>(evaluateKnights<false>);
+	}
+
+	static int timeBishops(Position&) {
+		return timePieces<Piece::B, Piece::b>(evaluateBishops<false>);
+	}
+
+	static int timeRooks(Position&) {
+		return timePieces<Piece::R, Piece::r>(evaluateRooks<false>);
+	}
+
+	static int timeQueens(Position&) {
+		return timePieces<Piece::Q, Piece::q>(evaluateQueens<false>);
+	}
+
+	static int timeKings(Position&) {
+		return timePieces<Piece::K, Piece::k>(evaluateKings<false>);
+	}
+
+	static int timeEvaluate(Position& pos) {
+		return Eval::evaluate(pos);
+	}
+
+	static const struct {
+		const char* name;
+		int (*run)(Position& pos);
+	} timedTerms[] = {
+		{ "phase + draw", timePhase },
+		{ "pawns", timePawns },
+		{ "knights", timeKnights },
+		{ "bishops", timeBishops },
+		{ "rooks", timeRooks },
+		{ "queens", timeQueens },
+		{ "kings", timeKings },
+		{ "evaluate", timeEvaluate },
+	};
+
+	static const int timedTermCount = sizeof(timedTerms) / sizeof(timedTerms[0]);
+
+	static void printTermTimings() {
+		const int iterations = 2000;
+
+		Position samplePos;
+		double ns[timedTermCount] = { 0 };
+		volatile int sink = 0; // keeps the optimizer from discarding the results
+
+		// the bench positions are the sample, parsing them clears the board and the game history, both are restored below
+		U64 bitboards[12], occupancies[3];
+		memcpy(bitboards, Bitboards::bitboards, sizeof(bitboards));
+		memcpy(occupancies, Bitboards::occupancies, sizeof(occupancies));
+
+		std::vector<U64> repetitionTable = Search::repetitionTable;
+		int repetitionIndex = Search::repetitionIndex;
+
+		for (int i = 0; i < Bench::fenCount; i++) {
+			samplePos.parseFen(Bench::fens[i]);
+			Eval::evaluate(samplePos); // sets the game phase the king term reads
+
+			for (int t = 0; t < timedTermCount; t++) {
+				auto start = std::chrono::steady_clock::now();
+
+				for (int n = 0; n < iterations; n++)
+					sink = sink + timedTerms[t].run(samplePos);
+
+				auto end = std::chrono::steady_clock::now();
+				ns[t] += static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+			}
+		}
+
+		memcpy(Bitboards::bitboards, bitboards, sizeof(bitboards));
+		memcpy(Bitboards::occupancies, occupancies, sizeof(occupancies));
+
+		Search::repetitionTable = repetitionTable;
+		Search::repetitionIndex = repetitionIndex;
+
+		double evaluateNs = ns[timedTermCount - 1] > 0.0 ? ns[timedTermCount - 1] : 1.0;
+
+		printf("\nTerm timings over %d positions, %d evaluations each\n", Bench::fenCount, iterations);
+		printf("%-16s %10s %8s\n", "term", "ns/eval", "share");
+
+		for (int t = 0; t < timedTermCount; t++)
+			printf("%-16s %10.1f %7.2f%%\n", timedTerms[t].name, ns[t] / (static_cast<double>(Bench::fenCount) * iterations), 100.0 * ns[t] / evaluateNs);
+	}
+
+	void Eval::trace(Position& pos) {
+		EvalTrace breakdown = {};
+
+		activeTrace = &breakdown;
+		int eval = evaluatePosition<true>(pos);
+		activeTrace = nullptr;
+
+		printf("\n%-16s | %13s | %13s | %13s\n", "Term", "White", "Black", "Total");
+		printf("%-16s | %6s %6s | %6s %6s | %6s %6s\n", "", "MG", "EG", "MG", "EG", "MG", "EG");
+		printf("-----------------+---------------+---------------+--------------\n");
+
+		PieceScore total[2];
+
+		for (int term = 0; term < TRACE_NB; term++) {
+			printTraceRow(traceTermNames[term], breakdown.terms[term][0], breakdown.terms[term][1]);
+
+			for (int side = 0; side < 2; side++)
+				scorePiece(&total[side], breakdown.terms[term][side].scoreOpening, breakdown.terms[term][side].scoreEndgame);
+		}
+
+		printf("-----------------+---------------+---------------+--------------\n");
+		printTraceRow("Total", total[0], total[1]);
+
+		const char* phaseNames[3] = { "opening", "endgame", "middlegame" };
+
+		printf("\nPhase: %s, phase score %d (opening above %d, endgame below %d)\n", phaseNames[phase.gamePhase], phase.phaseScore, openingScore, endgameScore);
+
+		if (phase.gamePhase == endgame && isDraw(pos))
+			printf("Drawn by insufficient material, the terms are not used\n");
+		else if (phase.gamePhase == middlegame)
+			printf("Interpolated: (%d * %d + %d * %d) / %d = %d\n", scores.scoreOpening, phase.phaseScore, scores.scoreEndgame, openingScore - phase.phaseScore, openingScore, scores.score);
+		else
+			printf("Pure %s score: %d\n", phaseNames[phase.gamePhase], scores.score);
+
+		printf("Evaluation: %d (white side), %d (side to move)\n", (pos.sideToMove == Colors::white) ? eval : -eval, eval);
+
+		printTermTimings();
+	}
+}
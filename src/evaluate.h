@@ -21,6 +21,7 @@ namespace Sloth {
 
         extern bool isEndgame();
         extern int evaluate(Position& pos);
+        void trace(Position& pos); // per term breakdown of evaluate for the eval command, plus term timings
     }
 }
 
@@ -1,3 +1,5 @@
+#include "allocguard.cpp"
+#include "bench.cpp"
 #include "bitboards.cpp"
 #include "evaluate.cpp"
 #include "magic.cpp"
@@ -7,6 +9,7 @@
 #include "perft.cpp"
 #include "piece.cpp"
 #include "position.cpp"
+#include "profile.cpp"
 #include "search.cpp"
 #include "time.cpp"
 #include "types.cpp"
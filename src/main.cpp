@@ -21,6 +21,7 @@
 
 #include "position.h"
 #include "perft.h"
+#include "bench.h"
 #include "uci.h"
 #include "search.h"
 #include "evaluate.h"
@@ -31,12 +32,44 @@ int main(int argc, char* argv[])
 {
     Magic::initAttacks();
     Bitboards::initLeaperAttacks();
+    Bitboards::initLineMasks();
     Zobrist::initRandomKeys();
+    Zobrist::initCuckoo();
     Search::initHashTable(64);
     Eval::initEvalMasks();
+    Search::initReductions();
+    Search::initStacks();
 
     bool debug = false;
 
+    // sloth perftsuite file.epd [maxdepth] [threads N] [hash MB] [bulk]
+    if (argc > 2 && !strcmp(argv[1], "perftsuite")) {
+        int maxDepth = (argc > 3) ? atoi(argv[3]) : 0;
+        int threads = 1, hashMb = 0;
+        bool bulk = false;
+
+        for (int i = 3; i < argc; i++) {
+            if (!strcmp(argv[i], "threads") && i + 1 < argc) threads = atoi(argv[++i]);
+            else if (!strcmp(argv[i], "hash") && i + 1 < argc) hashMb = atoi(argv[++i]);
+            else if (!strcmp(argv[i], "bulk")) bulk = true;
+        }
+
+        int failed = Perft::perftSuite(argv[2], maxDepth, threads, hashMb, bulk);
+
+        my_free(Search::hashTable);
+
+        return failed ? 1 : 0;
+    }
+
+    // sloth bench [depth]
+    if (argc > 1 && !strcmp(argv[1], "bench")) {
+        Bench::run((argc > 2) ? atoi(argv[2]) : 10);
+
+        my_free(Search::hashTable);
+
+        return 0;
+    }
+
     if (debug) {
         Position pos;
 
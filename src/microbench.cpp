@@ -0,0 +1,264 @@
+/*
+    Microbenchmarks for the engine's hot primitives.
+
+    This is a separate executable built from the same sources as glob.cpp
+    (everything except main.cpp), so the static helpers in search.cpp
+    (seeGE, readHashEntry, writeHashEntry) are reachable here as well.
+
+    Usage: sloth_microbench [samples] [iterations]
+*/
+
+#include "allocguard.cpp"
+#include "bench.cpp"
+#include "bitboards.cpp"
+#include "evaluate.cpp"
+#include "magic.cpp"
+#include "movegen.cpp"
+#include "perft.cpp"
+#include "piece.cpp"
+#include "position.cpp"
+#include "profile.cpp"
+#include "search.cpp"
+#include "time.cpp"
+#include "types.cpp"
+#include "uci.cpp"
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+using namespace Sloth;
+
+namespace {
+
+	// One snapshot per bench position, so kernels can restore a board without reparsing
+	struct BoardSnapshot {
+		U64 bitboards[12];
+		U64 occupancies[3];
+		Position pos;
+	};
+
+	std::vector<BoardSnapshot> snapshots;
+	std::vector<U64> ttKeys; // pseudo random keys for the TT kernels
+
+	volatile U64 sink = 0; // keeps the optimizer from discarding kernel results
+
+	void loadSnapshot(const BoardSnapshot& snap, Position& pos) {
+		memcpy(Bitboards::bitboards, snap.bitboards, sizeof(snap.bitboards));
+		memcpy(Bitboards::occupancies, snap.occupancies, sizeof(snap.occupancies));
+		pos = snap.pos;
+	}
+
+	void initSnapshots() {
+		for (int i = 0; i < Bench::fenCount; i++) {
+			BoardSnapshot snap;
+			snap.pos.parseFen(Bench::fens[i]);
+			memcpy(snap.bitboards, Bitboards::bitboards, sizeof(snap.bitboards));
+			memcpy(snap.occupancies, Bitboards::occupancies, sizeof(snap.occupancies));
+			snapshots.push_back(snap);
+		}
+
+		for (int i = 0; i < 65536; i++)
+			ttKeys.push_back(Magic::getRandomU64Num());
+	}
+
+	/*
+		A kernel runs once over the whole position set and returns the number of
+		primitive operations it performed. It is timed 'iterations' times per sample.
+	*/
+	typedef std::function<U64(Position&)> Kernel;
+
+	void runKernel(const char* name, const Kernel& kernel, int samples, int iterations) {
+		Position pos;
+		std::vector<double> nsPerOp;
+
+		kernel(pos); // warm up tables and caches
+
+		for (int s = 0; s < samples; s++) {
+			U64 ops = 0;
+
+			auto start = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < iterations; i++)
+				ops += kernel(pos);
+
+			auto end = std::chrono::steady_clock::now();
+			double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+			nsPerOp.push_back(ops ? ns / ops : 0.0);
+		}
+
+		double mean = 0.0, variance = 0.0;
+
+		for (double v : nsPerOp) mean += v;
+		mean /= samples;
+
+		for (double v : nsPerOp) variance += (v - mean) * (v - mean);
+		variance = (samples > 1) ? variance / (samples - 1) : 0.0;
+
+		printf("%-32s %10.2f %10.2f %10.2f%%\n", name, mean, std::sqrt(variance), mean > 0.0 ? 100.0 * std::sqrt(variance) / mean : 0.0);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Magic::initAttacks();
+	Bitboards::initLeaperAttacks();
+	Bitboards::initLineMasks();
+	Zobrist::initRandomKeys();
+	Zobrist::initCuckoo();
+	Search::initHashTable(64);
+	Eval::initEvalMasks();
+	Search::initReductions();
+	Search::initStacks();
+
+	int samples = (argc > 1) ? atoi(argv[1]) : 10;
+	int iterations = (argc > 2) ? atoi(argv[2]) : 2000;
+
+	if (samples < 1) samples = 1;
+	if (iterations < 1) iterations = 1;
+
+	initSnapshots();
+
+	printf("\nSloth %s microbenchmarks: %d positions, %d samples x %d iterations\n\n", VERSION, Bench::fenCount, samples, iterations);
+	printf("%-32s %10s %10s %11s\n", "kernel", "ns/op", "stddev", "rel");
+
+	runKernel("generateMoves(all)", [](Position& pos) -> U64 {
+		Movegen::MoveList moveList[1];
+
+		for (const BoardSnapshot& snap : snapshots) {
+			loadSnapshot(snap, pos);
+			Movegen::generateMoves(pos, moveList, false);
+			sink = sink + moveList->count;
+		}
+
+		return snapshots.size();
+	}, samples, iterations);
+
+	runKernel("generateMoves(captures)", [](Position& pos) -> U64 {
+		Movegen::MoveList moveList[1];
+
+		for (const BoardSnapshot& snap : snapshots) {
+			loadSnapshot(snap, pos);
+			Movegen::generateMoves(pos, moveList, true);
+			sink = sink + moveList->count;
+		}
+
+		return snapshots.size();
+	}, samples, iterations);
+
+	runKernel("makeMove + takeBack", [](Position& pos) -> U64 {
+		Movegen::MoveList moveList[1];
+		U64 ops = 0;
+
+		for (const BoardSnapshot& snap : snapshots) {
+			loadSnapshot(snap, pos);
+			Movegen::generateMoves(pos, moveList, false);
+
+			for (int c = 0; c < moveList->count; c++) {
+				copyBoard(pos);
+
+				if (pos.makeMove(pos, moveList->moves[c], MoveType::allMoves)) {
+					sink = sink + pos.hashKey;
+					takeBack(pos);
+				}
+
+				ops++;
+			}
+		}
+
+		return ops;
+	}, samples, iterations / 10 + 1);
+
+	runKernel("Eval::evaluate", [](Position& pos) -> U64 {
+		for (const BoardSnapshot& snap : snapshots) {
+			loadSnapshot(snap, pos);
+			sink = sink + Eval::evaluate(pos);
+		}
+
+		return snapshots.size();
+	}, samples, iterations);
+
+	runKernel("seeGE", [](Position& pos) -> U64 {
+		Movegen::MoveList moveList[1];
+		U64 ops = 0;
+
+		for (const BoardSnapshot& snap : snapshots) {
+			loadSnapshot(snap, pos);
+			Movegen::generateMoves(pos, moveList, true);
+
+			for (int c = 0; c < moveList->count; c++) {
+				sink = sink + seeGE(moveList->moves[c], pos, 0);
+				ops++;
+			}
+		}
+
+		return ops;
+	}, samples, iterations);
+
+	runKernel("Magic::getRookAttacks", [](Position&) -> U64 {
+		for (const BoardSnapshot& snap : snapshots) {
+			for (int sq = 0; sq < 64; sq++)
+				sink = sink + Magic::getRookAttacks(sq, snap.occupancies[Colors::both]);
+		}
+
+		return snapshots.size() * 64;
+	}, samples, iterations);
+
+	runKernel("Magic::getBishopAttacks", [](Position&) -> U64 {
+		for (const BoardSnapshot& snap : snapshots) {
+			for (int sq = 0; sq < 64; sq++)
+				sink = sink + Magic::getBishopAttacks(sq, snap.occupancies[Colors::both]);
+		}
+
+		return snapshots.size() * 64;
+	}, samples, iterations);
+
+	runKernel("Zobrist::generateHashKey", [](Position& pos) -> U64 {
+		for (const BoardSnapshot& snap : snapshots) {
+			loadSnapshot(snap, pos);
+			sink = sink + Zobrist::generateHashKey(pos);
+		}
+
+		return snapshots.size();
+	}, samples, iterations);
+
+	runKernel("isSquareAttacked", [](Position& pos) -> U64 {
+		for (const BoardSnapshot& snap : snapshots) {
+			loadSnapshot(snap, pos);
+
+			for (int sq = 0; sq < 64; sq++)
+				sink = sink + pos.isSquareAttacked(sq, pos.sideToMove ^ 1);
+		}
+
+		return snapshots.size() * 64;
+	}, samples, iterations);
+
+	// the TT kernels walk pseudo random keys so they measure memory latency, not a hot cache line
+	runKernel("TT writeHashEntry", [](Position& pos) -> U64 {
+		for (size_t i = 0; i < ttKeys.size(); i++) {
+			pos.hashKey = ttKeys[i];
+			writeHashEntry(static_cast<int>(i), 0, i & 31, hashfEXACT, pos.hashKey);
+		}
+
+		return ttKeys.size();
+	}, samples, iterations / 50 + 1);
+
+	runKernel("TT readHashEntry", [](Position& pos) -> U64 {
+		int bestMove = 0;
+		bool hit;
+
+		for (U64 key : ttKeys) {
+			pos.hashKey = key;
+			sink = sink + (readHashEntry(-VALUE_INFINITE, VALUE_INFINITE, &bestMove, 0, pos.hashKey, &hit) != nullptr);
+		}
+
+		return ttKeys.size();
+	}, samples, iterations / 50 + 1);
+
+	printf("\n");
+
+	my_free(Search::hashTable);
+
+	return 0;
+}
@@ -1,7 +1,5 @@
 #include <iostream>
-#include <unordered_map>
 #include <string>
-#include <sstream>
 
 #include "movegen.h"
 #include "bitboards.h"
@@ -23,16 +21,8 @@ namespace Sloth {
 		"a1", "b1", "c1", "d1", "e1", "f1", "g1", "h1",
 	};
 
-	std::unordered_map<Piece::Pieces, char> Movegen::promotedPieces = {
-		{Piece::Q, 'q'},
-		{Piece::R, 'r'},
-		{Piece::B, 'b'},
-		{Piece::N, 'n'},
-		{Piece::q, 'q'},
-		{Piece::r, 'r'},
-		{Piece::b, 'b'},
-		{Piece::n, 'n'}
-	};
+	// promotion letter by piece, indexed directly so printing a move never touches the heap
+	const char Movegen::promotedPieces[12] = { 0, 'n', 'b', 'r', 'q', 0, 0, 'n', 'b', 'r', 'q', 0 };
 
 	void Movegen::printMove(int move) {
 		if (getMovePromotion(move)) {
@@ -43,18 +33,19 @@ namespace Sloth {
 		}
 	}
 
-	std::string Movegen::moveToString(int move) {
-		std::stringstream ss;
-		if (getMovePromotion(move)) {
-			Piece::Pieces promotion = static_cast<Piece::Pieces>(getMovePromotion(move));
-			ss << squareToCoordinates[getMoveSource(move)]
-				<< squareToCoordinates[getMoveTarget(move)]
-				<< promotedPieces[promotion];
-		} else {
-			ss << squareToCoordinates[getMoveSource(move)]
-				<< squareToCoordinates[getMoveTarget(move)];
-		}
-		return ss.str();
+	// writes the move in coordinate notation into buffer, which must hold at least 6 chars
+	const char* Movegen::moveToString(int move, char* buffer) {
+		const char* source = squareToCoordinates[getMoveSource(move)];
+		const char* target = squareToCoordinates[getMoveTarget(move)];
+
+		buffer[0] = source[0];
+		buffer[1] = source[1];
+		buffer[2] = target[0];
+		buffer[3] = target[1];
+		buffer[4] = getMovePromotion(move) ? promotedPieces[getMovePromotion(move)] : 0;
+		buffer[5] = 0;
+
+		return buffer;
 	}
 
 	void Movegen::printMoveList(MoveList* moveList) {
@@ -73,6 +64,8 @@ namespace Sloth {
 	}
 
 	void Movegen::generateMoves(Position& pos, MoveList* moveList, bool captures) {
+		PHASE_TIMER(MoveGen);
+
 		moveList->count = 0;
 		int sourceSquare, target;
 		U64 bb, attacks;
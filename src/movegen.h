@@ -2,9 +2,7 @@
 #define MOVEGEN_H_INCLUDED
 
 #include <iostream>
-#include <unordered_map>
 #include <string>
-#include <sstream>
 
 #include "position.h"
 #include "piece.h"
@@ -54,10 +52,10 @@ namespace Sloth {
             moveList->count++;
         }
 
-        extern std::unordered_map<Piece::Pieces, char> promotedPieces;
+        extern const char promotedPieces[12];
 
         extern  void printMove(int move);
-        extern  std::string moveToString(int move);
+        extern  const char* moveToString(int move, char* buffer);
         extern  void printMoveList(MoveList* moveList);
 
 		//extern  void generateMoves(Position &pos, MoveList* moveCount);
@@ -1,30 +1,101 @@
-//#include <omp.h>
 #include <string>
 #include <iomanip>
 #include <sstream>
+#include <thread>
+#include <atomic>
+#include <vector>
 #include "perft.h"
 #include "position.h"
 #include "movegen.h"
 
 namespace Sloth {
-	long Perft::nodes = 0;
+	Perft::PerftEntry* Perft::hashTable = NULL;
+	U64 Perft::hashBuckets = 0;
+	bool Perft::bulkCounting = false;
 
-	void Perft::perft(int depth, Position& pos) {
+	/*
+		Buckets hold two entries: the first one is depth preferred, the second one is always replaced.
+		Results at depth 1 are cheaper to recompute than to look up, so only depth >= 2 is hashed.
+	*/
+	void Perft::initHashTable(int mb) {
+		freeHashTable();
+
+		if (mb <= 0) return;
+
+		hashBuckets = (0x100000ULL * mb) / (2 * sizeof(PerftEntry));
+		hashTable = (PerftEntry*)calloc(hashBuckets * 2, sizeof(PerftEntry));
+
+		if (hashTable == NULL) {
+			printf("info string Couldnt allocate memory for perft hash, running without it\n");
+			hashBuckets = 0;
+		}
+	}
+
+	void Perft::freeHashTable() {
+		if (hashTable != NULL) free(hashTable);
+
+		hashTable = NULL;
+		hashBuckets = 0;
+	}
+
+	static bool probePerftHash(U64 key, int depth, U64& nodes) {
+		Perft::PerftEntry* bucket = &Perft::hashTable[(key % Perft::hashBuckets) * 2];
+
+		for (int i = 0; i < 2; i++) {
+			U64 data = bucket[i].data;
+
+			if ((bucket[i].key ^ data) == key && static_cast<int>(data & 0xff) == depth) {
+				nodes = data >> 8;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	static void storePerftHash(U64 key, int depth, U64 nodes) {
+		Perft::PerftEntry* bucket = &Perft::hashTable[(key % Perft::hashBuckets) * 2];
+		U64 data = (nodes << 8) | static_cast<U64>(depth);
+
+		Perft::PerftEntry* entry = (depth >= static_cast<int>(bucket[0].data & 0xff)) ? &bucket[0] : &bucket[1];
+
+		entry->key = key ^ data;
+		entry->data = data;
+	}
+
+	U64 Perft::perft(int depth, Position& pos) {
 		if (depth == 0) {
-			nodes++;
-			return;
+			return 1ULL;
 		}
 
+		U64 nodes = 0;
+
+		if (hashTable != NULL && depth >= 2 && probePerftHash(pos.hashKey, depth, nodes))
+			return nodes;
+
 		Movegen::MoveList moveList;
 		Movegen::generateMoves(pos, &moveList, false);
 
+		// bulk counting: the leaves are the legal moves of this node, no need to make them
+		if (depth == 1 && bulkCounting) {
+			for (int c = 0; c < moveList.count; c++)
+				nodes += pos.isLegal(moveList.moves[c]);
+
+			return nodes;
+		}
+
 		for (int c = 0; c < moveList.count; c++) {
 			copyBoard(pos);
 			if (pos.makeMove(pos, moveList.moves[c], MoveType::allMoves)) {
-				perft(depth - 1, pos);
+				nodes += perft(depth - 1, pos);
 				takeBack(pos);
 			}
 		}
+
+		if (hashTable != NULL && depth >= 2)
+			storePerftHash(pos.hashKey, depth, nodes);
+
+		return nodes;
 	}
 
 	std::string formatNumber(long long number) {
@@ -34,38 +105,265 @@ namespace Sloth {
 		return std::to_string(number);
 	}
 
-	void Perft::perftTest(int depth, Position& pos) {
-		const char* squareToCoordinates[] = {
-			"a8", "b8", "c8", "d8", "e8", "f8", "g8", "h8",
-			"a7", "b7", "c7", "d7", "e7", "f7", "g7", "h7",
-			"a6", "b6", "c6", "d6", "e6", "f6", "g6", "h6",
-			"a5", "b5", "c5", "d5", "e5", "f5", "g5", "h5",
-			"a4", "b4", "c4", "d4", "e4", "f4", "g4", "h4",
-			"a3", "b3", "c3", "d3", "e3", "f3", "g3", "h3",
-			"a2", "b2", "c2", "d2", "e2", "f2", "g2", "h2",
-			"a1", "b1", "c1", "d1", "e1", "f1", "g1", "h1",
-		};
-
-		nodes = 0;
-		printf("\nPerft\n");
+	/*
+		Threaded perft
+
+		The tree is split at the first two plies: every legal (root move, reply) pair becomes a work
+		item, which gives the workers enough small pieces to stay balanced even with few root moves.
+		Each worker loads its own copy of the board (the bitboards are thread local) and pulls work
+		items from a shared counter. The per item counts are summed back into the root moves afterwards.
+	*/
+	struct PerftWork {
+		int rootIndex;
+		int rootMove;
+		int reply; // 0 when the tree is only split at the root
+		U64 nodes;
+	};
+
+	static void perftWorker(std::vector<PerftWork>& work, std::atomic<int>& next, int depth, const Position& rootPos, const U64* bbs, const U64* occ) {
+		memcpy(Bitboards::bitboards, bbs, sizeof(Bitboards::bitboards));
+		memcpy(Bitboards::occupancies, occ, sizeof(Bitboards::occupancies));
 
+		Position pos = rootPos;
+
+		for (int i = next++; i < static_cast<int>(work.size()); i = next++) {
+			PerftWork& item = work[i];
+
+			copyBoard(pos);
+			pos.makeMove(pos, item.rootMove, MoveType::allMoves);
+
+			if (item.reply) {
+				copyBoard(pos);
+				pos.makeMove(pos, item.reply, MoveType::allMoves);
+				item.nodes = Perft::perft(depth - 2, pos);
+				takeBack(pos);
+			} else {
+				item.nodes = Perft::perft(depth - 1, pos);
+			}
+
+			takeBack(pos);
+		}
+	}
+
+	static void splitPerft(int depth, Position& pos, int threads, std::vector<int>& rootMoves, std::vector<U64>& rootNodes) {
+		std::vector<PerftWork> work;
+
+		for (int r = 0; r < static_cast<int>(rootMoves.size()); r++) {
+			if (depth < 3) {
+				work.push_back({ r, rootMoves[r], 0, 0 });
+				continue;
+			}
+
+			copyBoard(pos);
+			pos.makeMove(pos, rootMoves[r], MoveType::allMoves);
+
+			Movegen::MoveList replies;
+			Movegen::generateMoves(pos, &replies, false);
+
+			for (int c = 0; c < replies.count; c++) {
+				copyBoard(pos);
+				if (pos.makeMove(pos, replies.moves[c], MoveType::allMoves)) {
+					takeBack(pos);
+					work.push_back({ r, rootMoves[r], replies.moves[c], 0 });
+				}
+			}
+
+			takeBack(pos);
+		}
+
+		U64 bbs[12], occ[3];
+		memcpy(bbs, Bitboards::bitboards, sizeof(bbs));
+		memcpy(occ, Bitboards::occupancies, sizeof(occ));
+
+		std::atomic<int> next(0);
+		std::vector<std::thread> workers;
+
+		for (int t = 0; t < threads; t++)
+			workers.emplace_back(perftWorker, std::ref(work), std::ref(next), depth, std::cref(pos), bbs, occ);
+
+		for (std::thread& worker : workers)
+			worker.join();
+
+		for (const PerftWork& item : work)
+			rootNodes[item.rootIndex] += item.nodes;
+	}
+
+	// runs perft from the current position and fills in the divide counts of every legal root move
+	static U64 perftDivide(int depth, Position& pos, int threads, std::vector<int>& rootMoves, std::vector<U64>& rootNodes) {
 		Movegen::MoveList moveList;
 		Movegen::generateMoves(pos, &moveList, false);
 
-		long start = getTimeMs();
+		rootMoves.clear();
 
 		for (int c = 0; c < moveList.count; c++) {
 			copyBoard(pos);
 			if (pos.makeMove(pos, moveList.moves[c], MoveType::allMoves)) {
-				long cumulativeNodes = nodes;
-				perft(depth - 1, pos);
-				printf("Move: %s%s%c Nodes: %ld\n", squareToCoordinates[getMoveSource(moveList.moves[c])], squareToCoordinates[getMoveTarget(moveList.moves[c])], Movegen::promotedPieces[static_cast<Piece::Pieces>(getMovePromotion(moveList.moves[c]))], nodes - cumulativeNodes);
+				rootMoves.push_back(moveList.moves[c]);
+				takeBack(pos);
+			}
+		}
+
+		rootNodes.assign(rootMoves.size(), 0);
+
+		if (threads > 1 && depth > 1) {
+			splitPerft(depth, pos, threads, rootMoves, rootNodes);
+		} else {
+			for (size_t r = 0; r < rootMoves.size(); r++) {
+				copyBoard(pos);
+				pos.makeMove(pos, rootMoves[r], MoveType::allMoves);
+				rootNodes[r] = Perft::perft(depth - 1, pos);
 				takeBack(pos);
 			}
 		}
 
+		U64 nodes = 0;
+
+		for (U64 count : rootNodes)
+			nodes += count;
+
+		return nodes;
+	}
+
+	static void printDivide(const std::vector<int>& rootMoves, const std::vector<U64>& rootNodes) {
+		for (size_t r = 0; r < rootMoves.size(); r++) {
+			printf("Move: ");
+			Movegen::printMove(rootMoves[r]);
+			printf(" Nodes: %llu\n", static_cast<unsigned long long>(rootNodes[r]));
+		}
+	}
+
+	void Perft::perftTest(int depth, Position& pos, int threads, int hashMb, bool bulk) {
+		if (depth < 1) depth = 1;
+		if (threads < 1) threads = 1;
+
+		printf("\nPerft\n");
+
+		initHashTable(hashMb);
+		bulkCounting = bulk;
+
+		std::vector<int> rootMoves;
+		std::vector<U64> rootNodes;
+
+		long start = getTimeMs();
+
+		U64 nodes = perftDivide(depth, pos, threads, rootMoves, rootNodes);
+
 		long time = getTimeMs() - start;
-		printf("\nDepth: %d\nNodes: %ld\nNodes per second: %s\nTime: %ld ms\n", depth, nodes, formatNumber(static_cast<long long>(nodes / (time / 1000.0))).c_str(), time);
+		if (time == 0) time = 1;
+
+		printDivide(rootMoves, rootNodes);
+
+		freeHashTable();
+		bulkCounting = false;
+
+		U64 nps = static_cast<U64>(nodes / (time / 1000.0));
+
+		printf("\nDepth: %d\nThreads: %d\nHash: %d MB\nMode: %s\nNodes: %llu\nNodes per second: %s\nTime: %ld ms\n", depth, threads, hashMb > 0 ? hashMb : 0, bulk ? "bulk" : "make", static_cast<unsigned long long>(nodes), formatNumber(static_cast<long long>(nps)).c_str(), time);
 	}
-}
 
+	/*
+		Perft suite
+
+		Reads standard perft EPD lines such as
+			rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 ;D1 20 ;D2 400 ;D3 8902
+		and checks every depth up to maxDepth. The FEN may omit the halfmove and fullmove fields.
+		The divide of the first failing position is printed, so the faulty subtree can be followed down.
+	*/
+	int Perft::perftSuite(const char* fileName, int maxDepth, int threads, int hashMb, bool bulk) {
+		FILE* file = fopen(fileName, "r");
+
+		if (file == NULL) {
+			printf("Couldnt open perft suite %s\n", fileName);
+			return 1;
+		}
+
+		if (maxDepth < 1) maxDepth = 64;
+		if (threads < 1) threads = 1;
+
+		initHashTable(hashMb);
+		bulkCounting = bulk;
+
+		printf("\nPerft suite: %s\nMax depth: %d\nThreads: %d\nHash: %d MB\nMode: %s\n\n", fileName, maxDepth, threads, hashMb > 0 ? hashMb : 0, bulk ? "bulk" : "make");
+
+		char line[1024];
+		int positions = 0, failed = 0;
+		bool dividePrinted = false;
+		U64 totalNodes = 0;
+		long totalTime = 0;
+
+		std::vector<int> rootMoves;
+		std::vector<U64> rootNodes;
+
+		Position pos;
+
+		while (fgets(line, sizeof(line), file)) {
+			char* fields = strchr(line, ';');
+
+			if (fields == NULL) continue; // blank lines and comments
+
+			if (fields - line < 2) continue; // no room for a FEN before the first field
+
+			*fields++ = 0;
+
+			for (char* end = fields - 2; end >= line && (*end == ' ' || *end == '\t'); end--)
+				*end = 0;
+
+			char fen[sizeof(line) + 4]; // room for the line and the move counters it may lack
+			int spaces = 0;
+
+			for (char* c = line; *c; c++)
+				if (*c == ' ' && c[1] != ' ') spaces++;
+
+			snprintf(fen, sizeof(fen), "%s%s", line, (spaces < 4) ? " 0 1" : "");
+
+			positions++;
+			bool passed = true;
+
+			for (char* field = strtok(fields, ";"); field && passed; field = strtok(NULL, ";")) {
+				while (*field == ' ') field++;
+
+				if (*field != 'D') continue;
+
+				int depth = atoi(field + 1);
+				U64 expected = strtoull(strchr(field, ' ') ? strchr(field, ' ') : field + 1, NULL, 10);
+
+				if (depth < 1 || depth > maxDepth) continue;
+
+				pos.parseFen(fen);
+
+				long start = getTimeMs();
+				U64 nodes = perftDivide(depth, pos, threads, rootMoves, rootNodes);
+				long time = getTimeMs() - start;
+
+				totalNodes += nodes;
+				totalTime += time;
+
+				if (nodes != expected) {
+					passed = false;
+					failed++;
+
+					printf("%4d FAIL depth %d expected %llu got %llu  %s\n", positions, depth, static_cast<unsigned long long>(expected), static_cast<unsigned long long>(nodes), fen);
+
+					if (!dividePrinted) {
+						printDivide(rootMoves, rootNodes);
+						printf("\n");
+						dividePrinted = true;
+					}
+				}
+			}
+
+			if (passed) printf("%4d OK    %s\n", positions, fen);
+		}
+
+		fclose(file);
+
+		freeHashTable();
+		bulkCounting = false;
+
+		if (totalTime == 0) totalTime = 1;
+
+		printf("\nPassed: %d / %d\nNodes: %llu\nNodes per second: %s\nTime: %ld ms\n", positions - failed, positions, static_cast<unsigned long long>(totalNodes), formatNumber(static_cast<long long>(totalNodes / (totalTime / 1000.0))).c_str(), totalTime);
+
+		return failed;
+	}
+}
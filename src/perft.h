@@ -1,4 +1,3 @@
-
 #pragma once
 
 #include "position.h"
@@ -11,9 +10,22 @@ namespace Sloth {
 			return getTickCount();
 		}
 
-		extern long nodes;
-		extern  void perft(int depth, Position& pos);
-		void perftTest(int depth, Position& pos);
+		// perft hash: (key, depth) -> node count, shared between perft threads
+		typedef struct {
+			U64 key; // hash key xor data, so a torn write from another thread fails verification
+			U64 data; // node count << 8 | depth
+		} PerftEntry;
+
+		extern PerftEntry* hashTable;
+		extern U64 hashBuckets;
+
+		extern bool bulkCounting; // count legal moves at the last ply instead of making them
+
+		void initHashTable(int mb);
+		void freeHashTable();
+
+		extern  U64 perft(int depth, Position& pos);
+		void perftTest(int depth, Position& pos, int threads, int hashMb, bool bulk);
+		int perftSuite(const char* fileName, int maxDepth, int threads, int hashMb, bool bulk); // returns the number of failed positions
 	}
 }
-
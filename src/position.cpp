@@ -19,25 +19,96 @@ namespace Sloth {
 	U64 Zobrist::castlingKeys[16];
 	U64 Zobrist::sideKey;
 
+	U64 Zobrist::cuckoo[8192];
+	int Zobrist::cuckooMove[8192];
+
+	/*
+		xorshift64* generator for the Zobrist keys.
+		Magic::getRandomU64Num is built from a 32 bit xorshift, whose output is linear over GF(2) in a 32 bit state,
+		so every key it produces lies in the same 32 dimensional subspace and different positions collide
+		systematically. The multiplication in xorshift64* breaks that linearity.
+	*/
+	static U64 zobristState = 1070372ULL;
+
+	static U64 getZobristKey() {
+		zobristState ^= zobristState >> 12;
+		zobristState ^= zobristState << 25;
+		zobristState ^= zobristState >> 27;
+
+		return zobristState * 2685821657736338717ULL;
+	}
+
 	void Zobrist::initRandomKeys() {
 
-		Magic::randomState = 1804289383;
+		zobristState = 1070372ULL;
 
 		for (int piece = Piece::P; piece <= Piece::k; piece++) {
 			for (int sq = 0; sq < 64; sq++) {
-				Zobrist::pieceKeys[piece][sq] = Magic::getRandomU64Num();
+				Zobrist::pieceKeys[piece][sq] = getZobristKey();
 			}
 		}
 
 		for (int sq = 0; sq < 64; sq++) {
-			Zobrist::enPassantKeys[sq] = Magic::getRandomU64Num();
+			Zobrist::enPassantKeys[sq] = getZobristKey();
 		}
 
 		for (int i = 0; i < 16; i++) {
-			Zobrist::castlingKeys[i] = Magic::getRandomU64Num();
+			Zobrist::castlingKeys[i] = getZobristKey();
 		}
 
-		Zobrist::sideKey = Magic::getRandomU64Num();
+		Zobrist::sideKey = getZobristKey();
+	}
+
+	/*
+		Upcoming repetition detection (Marcel van Kervinck's cuckoo method, as used in Stockfish).
+		Every reversible move of a non pawn piece between two squares it attacks on an empty board is stored by its
+		key difference. If the difference between the current key and a key some plies back is one of these, a
+		single move could bring that position back. There are 3668 such moves and each one fits in one of its
+		two slots.
+	*/
+	void Zobrist::initCuckoo() {
+		memset(cuckoo, 0, sizeof(cuckoo));
+		memset(cuckooMove, 0, sizeof(cuckooMove));
+
+		int count = 0;
+
+		for (int piece = Piece::N; piece <= Piece::k; piece++) {
+			if (piece == Piece::p) continue;
+
+			for (int s1 = 0; s1 < 64; s1++) {
+				U64 attacks;
+
+				switch (piece % 6) {
+				case Piece::N: attacks = knightAttacks[s1]; break;
+				case Piece::B: attacks = Magic::getBishopAttacks(s1, 0ULL); break;
+				case Piece::R: attacks = Magic::getRookAttacks(s1, 0ULL); break;
+				case Piece::Q: attacks = Magic::getBishopAttacks(s1, 0ULL) | Magic::getRookAttacks(s1, 0ULL); break;
+				default: attacks = kingAttacks[s1]; break;
+				}
+
+				for (int s2 = s1 + 1; s2 < 64; s2++) {
+					if (!getBit(attacks, s2)) continue;
+
+					U64 key = pieceKeys[piece][s1] ^ pieceKeys[piece][s2] ^ sideKey;
+					int move = s1 | (s2 << 6);
+					int slot = cuckooH1(key);
+
+					// insert, kicking the previous occupant to its other slot until an empty one is found
+					while (true) {
+						std::swap(cuckoo[slot], key);
+						std::swap(cuckooMove[slot], move);
+
+						if (move == 0) break;
+
+						slot = (slot == cuckooH1(key)) ? cuckooH2(key) : cuckooH1(key);
+					}
+
+					count++;
+				}
+			}
+		}
+
+		if (count != 3668) printf("info string Cuckoo table holds %d moves, expected 3668\n", count);
 	}
 
 	U64 Zobrist::generateHashKey(Position& pos) { // generate unique hash key
@@ -68,6 +139,8 @@ namespace Sloth {
 	}
 
 	int Position::makeMove(Position& pos, int move, int moveFlag) {
+		PHASE_TIMER(MakeMove);
+
 		// quiet
 		if (moveFlag == MoveType::allMoves) {
 			copyBoard(pos);
@@ -255,7 +328,7 @@ namespace Sloth {
 		fifty = 0;
 
 		Search::repetitionIndex = 0;
-		memset(Search::repetitionTable, 0ULL, sizeof(Search::repetitionTable));
+		Search::repetitionTable.assign(Search::repetitionTable.size(), 0ULL);
 
 		//printf("\nply: %d\n", Search::ply);
 
@@ -424,6 +497,118 @@ namespace Sloth {
 		return 0;
 	}
 
+	/*
+		Tests a pseudo legal move for legality without making it: the king may not be attacked once the
+		moving piece has left its source square and the captured piece (en passant included) is gone.
+		Castling through attacked squares is already filtered out by the move generator.
+	*/
+	int Position::isLegal(int move) {
+		int sourceSquare = getMoveSource(move);
+		int targetSquare = getMoveTarget(move);
+		int piece = getMovePiece(move);
+		int king = (sideToMove == Colors::white) ? Piece::K : Piece::k;
+
+		int kingSquare = (piece == king) ? targetSquare : getLs1bIndex(bitboards[king]);
+
+		U64 removed = 1ULL << targetSquare;
+		U64 occ = (occupancies[both] ^ (1ULL << sourceSquare)) | removed;
+
+		if (getMoveEnpassant(move)) {
+			int capturedSquare = (sideToMove == Colors::white) ? targetSquare + 8 : targetSquare - 8;
+
+			occ ^= 1ULL << capturedSquare;
+			removed |= 1ULL << capturedSquare;
+		}
+
+		return (attackersTo(kingSquare, occ) & occupancies[sideToMove ^ 1] & ~removed) == 0;
+	}
+
+	void Position::checkInfo(CheckInfo& ci) {
+		int us = sideToMove;
+		U64 occ = occupancies[both];
+
+		ci.kingSquare = getLs1bIndex(bitboards[(us == Colors::white) ? Piece::k : Piece::K]);
+
+		U64 bishopChecks = Magic::getBishopAttacks(ci.kingSquare, occ);
+		U64 rookChecks = Magic::getRookAttacks(ci.kingSquare, occ);
+
+		ci.checkSquares[Piece::P] = Bitboards::pawnAttacks[us ^ 1][ci.kingSquare];
+		ci.checkSquares[Piece::N] = knightAttacks[ci.kingSquare];
+		ci.checkSquares[Piece::B] = bishopChecks;
+		ci.checkSquares[Piece::R] = rookChecks;
+		ci.checkSquares[Piece::Q] = bishopChecks | rookChecks;
+		ci.checkSquares[Piece::K] = 0ULL;
+
+		int first = (us == Colors::white) ? Piece::P : Piece::p;
+		U64 diagonal = bitboards[first + Piece::B] | bitboards[first + Piece::Q];
+		U64 straight = bitboards[first + Piece::R] | bitboards[first + Piece::Q];
+
+		U64 snipers = (Magic::getBishopAttacks(ci.kingSquare, 0ULL) & diagonal) | (Magic::getRookAttacks(ci.kingSquare, 0ULL) & straight);
+
+		ci.discoverers = 0ULL;
+
+		while (snipers) {
+			int sniper = getLs1bIndex(snipers);
+			U64 blockers = Bitboards::betweenMasks[sniper][ci.kingSquare] & occ;
+
+			if (blockers && !(blockers & (blockers - 1)) && (blockers & occupancies[us]))
+				ci.discoverers |= blockers;
+
+			snipers &= snipers - 1;
+		}
+	}
+
+	/*
+		Tells whether a pseudo legal move gives check, before it is made. Ordinary moves only need the check squares
+		and the discovered check candidates. Promotions, en passant and castling change more than one square, so
+		those recompute the attacks on the king with the occupancy after the move.
+	*/
+	bool Position::givesCheck(int move, const CheckInfo& ci) {
+		int from = getMoveSource(move);
+		int to = getMoveTarget(move);
+		int first = (sideToMove == Colors::white) ? Piece::P : Piece::p;
+		int type = getMovePiece(move) - first;
+		int promoted = getMovePromotion(move);
+		U64 kingBB = 1ULL << ci.kingSquare;
+
+		if (!promoted && (ci.checkSquares[type] & (1ULL << to))) return true;
+
+		// the piece leaves a line to the king, unless it moves along that same line
+		if ((ci.discoverers & (1ULL << from)) && !(Bitboards::lineMasks[from][ci.kingSquare] & (1ULL << to))) return true;
+
+		U64 occ = (occupancies[both] ^ (1ULL << from)) | (1ULL << to);
+
+		if (promoted) {
+			switch (promoted - first) {
+			case Piece::N: return knightAttacks[to] & kingBB;
+			case Piece::B: return Magic::getBishopAttacks(to, occ) & kingBB;
+			case Piece::R: return Magic::getRookAttacks(to, occ) & kingBB;
+			default: return (Magic::getBishopAttacks(to, occ) | Magic::getRookAttacks(to, occ)) & kingBB;
+			}
+		}
+
+		// the captured pawn can uncover a slider on the king's line as well
+		if (getMoveEnpassant(move)) {
+			occ ^= 1ULL << ((sideToMove == Colors::white) ? to + 8 : to - 8);
+
+			U64 diagonal = bitboards[first + Piece::B] | bitboards[first + Piece::Q];
+			U64 straight = bitboards[first + Piece::R] | bitboards[first + Piece::Q];
+
+			return (Magic::getBishopAttacks(ci.kingSquare, occ) & diagonal) || (Magic::getRookAttacks(ci.kingSquare, occ) & straight);
+		}
+
+		if (getMoveCastling(move)) {
+			int rookFrom = (to == g1) ? h1 : (to == c1) ? a1 : (to == g8) ? h8 : a8;
+			int rookTo = (to == g1) ? f1 : (to == c1) ? d1 : (to == g8) ? f8 : d8;
+
+			occ = (occ ^ (1ULL << rookFrom)) | (1ULL << rookTo);
+
+			return Magic::getRookAttacks(rookTo, occ) & kingBB;
+		}
+
+		return false;
+	}
+
 	U64 Position::attackersTo(int sq, U64 occ) {
 		return (bitboards[Piece::P] & Bitboards::pawnAttacks[black][sq]) |
 			(bitboards[Piece::p] & Bitboards::pawnAttacks[white][sq]) |
@@ -7,6 +7,7 @@
 
 #include "bitboards.h"
 #include "time.h"
+#include "profile.h"
 
 #include "types.h"
 
@@ -21,12 +22,20 @@ namespace Sloth {
 		fifty = pos.fifty; \
 		U64 hashKeyCopy = pos.hashKey; \
 	
-	#define takeBack(pos) \
+	#define takeBack(pos) { \
+		PHASE_TIMER(TakeBack); \
 		memcpy(Bitboards::bitboards, bbsCopy, 96); \
 		memcpy(Bitboards::occupancies, occCopies, 24); \
 		pos.sideToMove = side; pos.enPassant = enPassant; pos.castle = castle; \
 		pos.fifty = fifty; \
-		pos.hashKey = hashKeyCopy; \
+		pos.hashKey = hashKeyCopy; } \
+
+	// what the side to move needs to know to tell whether a move gives check, without making it
+	struct CheckInfo {
+		U64 checkSquares[6]; // [piece type], squares from which that piece would attack the enemy king
+		U64 discoverers; // own pieces standing between an own slider and the enemy king
+		int kingSquare; // enemy king
+	};
 
 	class Position {
 	public:
@@ -45,6 +54,9 @@ namespace Sloth {
 		void printBoard();
 
 		int isSquareAttacked(int square, int side);
+		int isLegal(int move);
+		void checkInfo(CheckInfo& ci);
+		bool givesCheck(int move, const CheckInfo& ci);
 		U64 attackersTo(int square, U64 occ);
 		U64 pawnAttacks(int color);
 		U64 attackedBy(int color);
@@ -64,7 +76,15 @@ namespace Sloth {
 		extern U64 castlingKeys[16];
 		extern U64 sideKey;
 
+		// cuckoo tables of every reversible move key (a piece going from one square to another, plus the side key)
+		extern U64 cuckoo[8192];
+		extern int cuckooMove[8192]; // source | target << 6 of the move in the same slot
+
+		inline int cuckooH1(U64 key) { return static_cast<int>(key & 0x1fff); }
+		inline int cuckooH2(U64 key) { return static_cast<int>((key >> 16) & 0x1fff); }
+
 		void initRandomKeys();
+		void initCuckoo(); // needs the piece keys and the attack tables
 		U64 generateHashKey(Position& pos);
 	}
 }
@@ -0,0 +1,47 @@
+#include <cstdio>
+#include <cstring>
+
+#include "profile.h"
+
+namespace Sloth {
+	thread_local Profile::PhaseCounter Profile::counters[Profile::PHASE_NB];
+
+	// nested phases are indented under the phase that contains them
+	static const struct {
+		const char* name;
+		int indent;
+	} phaseNames[Profile::PHASE_NB] = {
+		{ "move generation", 0 },
+		{ "move ordering", 0 },
+		{ "makeMove", 0 },
+		{ "takeBack", 0 },
+		{ "evaluate", 0 },
+		{ "pawns", 1 },
+		{ "kings", 1 },
+		{ "pieces", 1 },
+		{ "see", 0 },
+		{ "tt probe", 0 },
+		{ "communicate", 0 },
+	};
+
+	void Profile::reset() {
+		memset(counters, 0, sizeof(counters));
+	}
+
+	void Profile::print(U64 totalCycles) {
+		if (totalCycles == 0) totalCycles = 1;
+
+		printf("\nPhase timers (cycles)\n");
+		printf("%-24s %14s %16s %10s %8s\n", "phase", "calls", "cycles", "per call", "share");
+
+		for (int phase = 0; phase < PHASE_NB; phase++) {
+			const PhaseCounter& counter = counters[phase];
+
+			printf("%*s%-*s %14llu %16llu %10.1f %7.2f%%\n", 2 * phaseNames[phase].indent, "", 24 - 2 * phaseNames[phase].indent, phaseNames[phase].name,
+				static_cast<unsigned long long>(counter.calls), static_cast<unsigned long long>(counter.cycles),
+				counter.calls ? static_cast<double>(counter.cycles) / counter.calls : 0.0, 100.0 * counter.cycles / totalCycles);
+		}
+
+		printf("%-24s %14s %16llu\n", "total", "", static_cast<unsigned long long>(totalCycles));
+	}
+}
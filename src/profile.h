@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+
+#include "bitboards.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+	Phase timers, for builds with PHASE_TIMERS defined (-DPHASE_TIMERS).
+
+	PHASE_TIMER(phase) opens a scoped timer that adds the cycles spent until the end of the enclosing
+	block to that phase. Phases nest: a timer inside another one is counted in both, so the evaluation
+	terms are part of Evaluate and SEE calls made while picking moves are part of MoveOrdering.
+	Without the flag the macro is empty and the hot path is untouched.
+*/
+#ifdef PHASE_TIMERS
+#define PHASE_TIMER(phase) Sloth::Profile::ScopedTimer phaseTimer(Sloth::Profile::phase)
+#else
+#define PHASE_TIMER(phase)
+#endif
+
+namespace Sloth {
+	namespace Profile {
+		enum Phase {
+			MoveGen,
+			MoveOrdering,
+			MakeMove,
+			TakeBack,
+			Evaluate,
+			EvalPawns,
+			EvalKings,
+			EvalPieces, // knights, bishops, rooks and queens
+			See,
+			TTProbe,
+			Communicate,
+			PHASE_NB
+		};
+
+		struct PhaseCounter {
+			U64 cycles;
+			U64 calls;
+		};
+
+		extern thread_local PhaseCounter counters[PHASE_NB];
+
+		// time stamp counter on x86, elsewhere nanoseconds stand in for cycles
+		static inline U64 readCycles() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+			return __rdtsc();
+#else
+			return static_cast<U64>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+		}
+
+		struct ScopedTimer {
+			Phase phase;
+			U64 start;
+
+			ScopedTimer(Phase p) : phase(p), start(readCycles()) {}
+
+			~ScopedTimer() {
+				counters[phase].cycles += readCycles() - start;
+				counters[phase].calls++;
+			}
+		};
+
+		void reset();
+		void print(U64 totalCycles); // breakdown of the counters against the cycles of the whole run
+	}
+}
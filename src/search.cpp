@@ -3,12 +3,15 @@
 #include <cstdio>
 #include <cmath>
 #include <cstdlib>
+#include <thread>
+#include <chrono>
 
 #include "search.h"
 #include "evaluate.h"
 #include "movegen.h"
 #include "magic.h"
 #include "uci.h"
+#include "allocguard.h"
 
 #undef clamp
 
@@ -19,18 +22,26 @@ namespace Sloth {
 	int Search::hashEntries = 0;
 	HASHE* Search::hashTable = NULL;
 
-	U64 Search::repetitionTable[1000];
+	std::vector<U64> Search::repetitionTable(1024);
 	int Search::repetitionIndex = 0;
 
 	const int reductionLimit = 3;
-	int pvLength[MAX_PLY];
-	int pvTable[MAX_PLY][MAX_PLY];
+	int reductions[MAX_PLY][64]; // [depth][moves searched], base late move reduction
 	int followPV, scorePV;
 	int Search::ply = 0;
 	int Search::contempt = 0;
+	int Search::iirDepth = 4;
+	bool Search::qsearchChecks = false;
+	thread_local Search::SearchStats Search::stats;
+	std::vector<Search::RootMove> Search::rootMoves;
+	std::vector<int> Search::searchMoves;
+	int Search::multiPV = 1;
+	int Search::pvIndex = 0;
 	unsigned long long nodes;
-	int killerMoves[2][MAX_PLY];
-	int historyMoves[12][64];
+	int historyMoves[12][64]; // [piece][to square]
+	int captureHistory[12][64][12]; // [piece][to square][captured piece]
+	int counterMoves[12][64]; // [previous piece][previous to square], the quiet reply that refuted it last time
+	int continuationHistory[12][64][12][64]; // [previous piece][previous to square][piece][to square]
 	int totalEntries = 0;
 	int usedEntries = 0;
 	int lastCurrmoveOutput = 0;
@@ -40,7 +51,35 @@ namespace Sloth {
 	const int lmpMargins[4] = { 0, 8, 12, 24 };
 	const int pieceValues[13] = { 100, 300, 300, 500, 900, VALUE_INFINITE, 100, 300, 300, 500, 900, VALUE_INFINITE, 0 };
 
-	double agingFactor = 0.9;
+	const int MAX_HISTORY = 16384;
+
+	/*
+		Per ply stacks. MAX_PLY is a build setting, and with a few hundred plies the PV table alone takes a
+		quarter of a megabyte, so the stacks are allocated once by initStacks instead of sitting in static storage.
+		Every stack has one spare ply: a node at MAX_PLY still touches its entries before it bails out.
+
+		The search stack also has two sentinel entries below ply 0, so the continuation history can look back
+		two plies without bound checks.
+	*/
+	const int STACK_PLIES = MAX_PLY + 1;
+
+	static int* pvLength = nullptr;
+	static int (*pvTable)[STACK_PLIES] = nullptr;
+	static int (*killerMoves)[STACK_PLIES] = nullptr; // [slot][ply]
+	static Search::SearchStack* searchStack = nullptr;
+	static Search::SearchStack* ss = nullptr;
+
+	void Search::initStacks() {
+		if (searchStack != nullptr) return;
+
+		pvLength = static_cast<int*>(my_malloc(STACK_PLIES * sizeof(int)));
+		pvTable = static_cast<int(*)[STACK_PLIES]>(my_malloc(STACK_PLIES * sizeof(*pvTable)));
+		killerMoves = static_cast<int(*)[STACK_PLIES]>(my_malloc(2 * sizeof(*killerMoves)));
+		searchStack = static_cast<Search::SearchStack*>(my_malloc((STACK_PLIES + 2) * sizeof(Search::SearchStack)));
+		ss = searchStack + 2;
+
+		Search::rootMoves.reserve(256); // a position has at most 218 legal moves, filling the list never reallocates
+	}
 
 	void Search::clearHashTable() {
 		if (game.time.ponder) return;
@@ -80,11 +119,13 @@ namespace Sloth {
 		}
 	}
 
-	static HASHE* readHashEntry(int alpha, int beta, int* bestMove, int depth, Position& pos, bool* hit) {
-		HASHE* hashEntry = &Search::hashTable[pos.hashKey % Search::hashEntries];
+	static HASHE* readHashEntry(int alpha, int beta, int* bestMove, int depth, U64 key, bool* hit) {
+		PHASE_TIMER(TTProbe);
+
+		HASHE* hashEntry = &Search::hashTable[key % Search::hashEntries];
 		*hit = false;
 
-		if (hashEntry->hashKey == pos.hashKey) {
+		if (hashEntry->hashKey == key) {
 			if (hashEntry->depth >= depth) {
 				int score = hashEntry->score;
 				if (score < -MATE_SCORE) score += Search::ply;
@@ -99,22 +140,55 @@ namespace Sloth {
 		return (*hit) ? hashEntry : nullptr;
 	}
 
-	static void writeHashEntry(int score, int bestMove, int depth, int hashFlag, Position& pos) {
-		HASHE* hashEntry = &Search::hashTable[pos.hashKey % Search::hashEntries];
+	static void writeHashEntry(int score, int bestMove, int depth, int hashFlag, U64 key) {
+		HASHE* hashEntry = &Search::hashTable[key % Search::hashEntries];
 
 		if (score < -MATE_SCORE) score -= Search::ply;
 		if (score > MATE_SCORE) score += Search::ply;
 
-		if (hashEntry->depth == 0)
+		if (hashEntry->hashKey == 0)
 			usedEntries++;
 
-		hashEntry->hashKey = pos.hashKey;
+		hashEntry->hashKey = key;
 		hashEntry->score = score;
 		hashEntry->flag = hashFlag;
 		hashEntry->depth = depth;
 		hashEntry->bestMove = bestMove;
 	}
 
+	/*
+		Late move reductions grow with the logarithm of both the remaining depth and the number of
+		moves already searched, so deep nodes prune their tail much harder than shallow ones.
+	*/
+	void Search::initReductions() {
+		for (int depth = 0; depth < MAX_PLY; depth++) {
+			for (int moves = 0; moves < 64; moves++) {
+				reductions[depth][moves] = (depth && moves) ? static_cast<int>(0.75 + log(depth) * log(moves) / 2.25) : 0;
+			}
+		}
+	}
+
+	// mate scores are stored relative to the node, convert them back to the distance from the root
+	static inline int scoreFromTT(int score) {
+		if (score < -MATE_SCORE) return score + Search::ply;
+		if (score > MATE_SCORE) return score - Search::ply;
+
+		return score;
+	}
+
+	// qsearch results are the cheapest to recompute, they never replace an entry from the main search
+	static void writeQsearchEntry(int score, int bestMove, int hashFlag, U64 key) {
+		HASHE* hashEntry = &Search::hashTable[key % Search::hashEntries];
+
+		if (hashEntry->hashKey == 0 || hashEntry->depth <= 0)
+			writeHashEntry(score, bestMove, 0, hashFlag, key);
+	}
+
+	// the singular extension search stores its results under a different key, so they never mix with the full node
+	static inline U64 exclusionKey(int excludedMove) {
+		return static_cast<U64>(excludedMove) * 0x9E3779B97F4A7C15ULL;
+	}
+
 	double hashFull() {
 		return 1000.0 * usedEntries / totalEntries;
 	}
@@ -130,6 +204,16 @@ namespace Sloth {
 		}
 	}
 
+	// root move entry of a move that is still searched in the current line, null for the moves of the lines above it
+	static Search::RootMove* findRootMove(int move) {
+		for (size_t i = Search::pvIndex; i < Search::rootMoves.size(); i++) {
+			if (Search::rootMoves[i].move == move)
+				return &Search::rootMoves[i];
+		}
+
+		return nullptr;
+	}
+
 	void Search::printMoveScores(Movegen::MoveList* moveList, Position& pos) {
 		for (int i = 0; i < moveList->count; i++) {
 			int move = moveList->moves[i];
@@ -138,6 +222,70 @@ namespace Sloth {
 		}
 	}
 
+	// piece standing on the target square of a capture, en passant captures take a pawn
+	static inline int capturedPiece(int move) {
+		int targetSquare = getMoveTarget(move);
+		int startPiece = (getMovePiece(move) < Piece::p) ? Piece::p : Piece::P;
+
+		for (int bbPiece = startPiece; bbPiece < startPiece + 6; bbPiece++) {
+			if (getBit(Bitboards::bitboards[bbPiece], targetSquare))
+				return bbPiece;
+		}
+
+		return startPiece;
+	}
+
+	static inline int historyBonus(int depth) {
+		return std::min(32 * depth * depth, 1600);
+	}
+
+	/*
+		Gravity update: the entry moves towards +-MAX_HISTORY by the bonus, and the closer it already is
+		the smaller the step. Entries stay bounded, so they never need to be aged.
+	*/
+	static inline void updateHistory(int& entry, int bonus) {
+		entry += bonus - entry * abs(bonus) / MAX_HISTORY;
+	}
+
+	static inline int& captureHistoryEntry(int move) {
+		return captureHistory[getMovePiece(move)][getMoveTarget(move)][capturedPiece(move)];
+	}
+
+	// continuation history of the move made 'offset' plies before 'ply', null after a null move or at the root
+	static inline int* continuationTable(int ply, int offset) {
+		const Search::SearchStack* prev = &ss[ply - offset];
+
+		return prev->move ? continuationHistory[prev->movedPiece][getMoveTarget(prev->move)][0] : nullptr;
+	}
+
+	// quiet move score at 'ply': butterfly history plus the 1-ply and 2-ply continuation histories
+	static inline int quietHistoryScore(int move, int ply) {
+		int piece = getMovePiece(move);
+		int target = getMoveTarget(move);
+		int score = historyMoves[piece][target];
+
+		if (int* cont = continuationTable(ply, 1)) score += cont[piece * 64 + target];
+		if (int* cont = continuationTable(ply, 2)) score += cont[piece * 64 + target];
+
+		return score;
+	}
+
+	static inline int counterMove() {
+		const Search::SearchStack* prev = &ss[Search::ply - 1];
+
+		return prev->move ? counterMoves[prev->movedPiece][getMoveTarget(prev->move)] : 0;
+	}
+
+	static void updateQuietHistories(int move, int bonus) {
+		int piece = getMovePiece(move);
+		int target = getMoveTarget(move);
+
+		updateHistory(historyMoves[piece][target], bonus);
+
+		if (int* cont = continuationTable(Search::ply, 1)) updateHistory(cont[piece * 64 + target], bonus);
+		if (int* cont = continuationTable(Search::ply, 2)) updateHistory(cont[piece * 64 + target], bonus);
+	}
+
 	int Search::scoreMove(int move, Position& pos) {
 		int score = 0;
 
@@ -149,42 +297,29 @@ namespace Sloth {
 		}
 
 		if (getMoveCapture(move)) {
-			int targetPiece = Piece::P;
-			int startPiece = (pos.sideToMove == Colors::white) ? Piece::p : Piece::P;
-			int endPiece = (pos.sideToMove == Colors::white) ? Piece::k : Piece::K;
-			U64 targetSquare = getMoveTarget(move);
-
-			for (int bbPiece = startPiece; bbPiece <= endPiece; bbPiece++) {
-				U64 bb = Bitboards::bitboards[bbPiece];
-				if (getBit(bb, targetSquare)) {
-					targetPiece = bbPiece;
-					break;
-				}
-			}
+			int targetPiece = capturedPiece(move);
 
-			score = MVV_LVA[getMovePiece(move)][targetPiece] + 10000;
+			// capture history can reorder captures of similar victims, but never lifts one below the quiets
+			score = MVV_LVA[getMovePiece(move)][targetPiece] + 10000 + captureHistory[getMovePiece(move)][getMoveTarget(move)][targetPiece] / 128;
 		} else {
-			int killerScore = 0;
-			
 			if (killerMoves[0][Search::ply] == move) {
-				killerScore = 9000.f * pow(agingFactor, Search::ply);
+				score = 9000;
 			} else if (killerMoves[1][Search::ply] == move) {
-				killerScore = 8000 * pow(agingFactor, Search::ply);
+				score = 8000;
+			} else if (counterMove() == move) {
+				score = 7000;
+			} else {
+				score = quietHistoryScore(move, Search::ply) / 8; // three tables bounded by MAX_HISTORY stay below the counter move
 			}
-
-			int historyScore = historyMoves[getMovePiece(move)][getMoveTarget(move)];
-			historyScore = historyScore * pow(agingFactor, Search::ply);
-		
-			if (pos.time.ponder) historyScore *= 0.85f;
-
-			score = (killerScore != 0) ? killerScore : historyScore;
 		}
 
 		return score;
 	}
 
 	void Search::sortMoves(Movegen::MoveList* moveList, int bestMove, Position& pos) {
-		int* moveScores = new int[moveList->count];
+		PHASE_TIMER(MoveOrdering);
+
+		int moveScores[256];
 
 		for (int i = 0; i < moveList->count; i++) {
 			if (bestMove == moveList->moves[i]) {
@@ -208,13 +343,31 @@ namespace Sloth {
 			moveList->moves[j + 1] = currentMove;
 			moveScores[j + 1] = currentScore;
 		}
+	}
 
-		delete[] moveScores;
+	/*
+		repetitionTable[repetitionIndex + 1 - k] holds the key from k plies ago. Only positions with the same side to
+		move can repeat, and nothing before the last irreversible move (fifty) or the last null move can, so the
+		scan covers every second entry of that window only.
+	*/
+	static inline U64 keyPliesAgo(int k) {
+		return Search::repetitionTable[Search::repetitionIndex + 1 - k];
 	}
 
-	static int isRepetition(Position& pos) {
-		for (int i = 0; i < Search::repetitionIndex; i++) {
-			if (Search::repetitionTable[i] == pos.hashKey) {
+	// plies the position can look back for repetitions
+	static int repetitionWindow(Position& pos) {
+		int end = std::min(pos.fifty, Search::repetitionIndex); // repetitionTable[0] holds no position
+
+		for (int k = 1; k <= std::min(end, Search::ply); k++) {
+			if (ss[Search::ply - k].move == 0) return k - 1; // null move k plies ago
+		}
+
+		return end;
+	}
+
+	static int isRepetition(Position& pos, int end) {
+		for (int k = 4; k <= end; k += 2) {
+			if (keyPliesAgo(k) == pos.hashKey) {
 				return 1;
 			}
 		}
@@ -222,6 +375,38 @@ namespace Sloth {
 		return 0;
 	}
 
+	/*
+		Is there a move that takes us back to a position from the search path? Then the side to move can force a
+		draw by repetition, one ply before the repetition itself is on the board. The keys of the positions in
+		between have to cancel out (other == 0), and the move found in the cuckoo table needs a free path. Cycles
+		reaching back before the root are left to the regular repetition check.
+	*/
+	static bool hasUpcomingRepetition(Position& pos, int end) {
+		if (end < 3) return false;
+
+		U64 originalKey = pos.hashKey;
+		U64 other = originalKey ^ keyPliesAgo(1) ^ Zobrist::sideKey;
+
+		for (int i = 3; i <= end; i += 2) {
+			other ^= keyPliesAgo(i - 1) ^ keyPliesAgo(i) ^ Zobrist::sideKey;
+
+			if (other != 0) continue;
+
+			U64 moveKey = originalKey ^ keyPliesAgo(i);
+			int slot = Zobrist::cuckooH1(moveKey);
+
+			if (Zobrist::cuckoo[slot] != moveKey) slot = Zobrist::cuckooH2(moveKey);
+			if (Zobrist::cuckoo[slot] != moveKey) continue;
+
+			int move = Zobrist::cuckooMove[slot];
+
+			if (!(Bitboards::betweenMasks[move & 63][move >> 6] & Bitboards::occupancies[Colors::both]) && Search::ply > i)
+				return true;
+		}
+
+		return false;
+	}
+
 	static bool isEndgame(Position& pos) {
 		int pawnMaterial = Bitboards::countBits(Bitboards::bitboards[Piece::P] | Bitboards::bitboards[Piece::p]) * 100;
 		int knightMaterial = Bitboards::countBits(Bitboards::bitboards[Piece::N] | Bitboards::bitboards[Piece::n]) * 320;
@@ -239,105 +424,145 @@ namespace Sloth {
 			return pos.sideToMove == Colors::white ? -Search::contempt : Search::contempt;
 	}
 
-	static U64 considerXrays(int sq, U64 occ) {
-		U64 attackers = 0ULL;
-		U64 attackingBishops = Bitboards::bitboards[Piece::B] | Bitboards::bitboards[Piece::b];
-		U64 attackingRooks = Bitboards::bitboards[Piece::R] | Bitboards::bitboards[Piece::r];
-		U64 attackingQueens = Bitboards::bitboards[Piece::Q] | Bitboards::bitboards[Piece::q];
+	/*
+		Static exchange evaluation against a threshold
 
-		U64 intercardinalRays = Magic::getBishopAttacks(sq, occ);
-		U64 cardinalRays = Magic::getRookAttacks(sq, occ);
+		Answers whether the exchange sequence started by move wins at least threshold, without building the whole
+		gain list. Both sides keep swapping in their least valuable attacker, and the loop stops as soon as the side
+		to recapture can no longer change the outcome. Sliders behind a capturing piece are added as x-rays when it
+		leaves the board. Promotions count the promoted piece on both sides of the balance, en passant captures the
+		pawn behind the target square.
+	*/
+	static bool seeGE(int move, Position& pos, int threshold) {
+		PHASE_TIMER(See);
 
-		attackers |= intercardinalRays & (attackingBishops | attackingQueens);
-		attackers |= cardinalRays & (attackingRooks | attackingQueens);
+		if (getMoveCastling(move)) return threshold <= 0;
 
-		return attackers;
-	}
+		int from = getMoveSource(move);
+		int to = getMoveTarget(move);
+		int promoted = getMovePromotion(move);
 
-	static U64 minAttacker(U64 attadef, int sideToMove, int& attacker) {
-		int startPiece = Piece::P;
-		int endPiece = Piece::K;
+		int swap = (getMoveCapture(move) ? pieceValues[capturedPiece(move)] : 0) - threshold;
 
-		if (sideToMove == Colors::black) {
-			startPiece = Piece::p;
-			endPiece = Piece::k;
-		}
+		if (promoted) swap += pieceValues[promoted] - pieceValues[Piece::P];
+		if (swap < 0) return false;
 
-		for (attacker = startPiece; attacker <= endPiece; attacker++) {
-			U64 subset = attadef & Bitboards::bitboards[attacker];
-			if (subset) return (subset & (0 - subset));
-		}
+		swap = pieceValues[promoted ? promoted : getMovePiece(move)] - swap;
+		if (swap <= 0) return true;
 
-		return 0;
-	}
+		U64 occupied = Bitboards::occupancies[Colors::both] ^ (1ULL << from) ^ (1ULL << to);
 
-	static int see(int move, Position& pos) {
-		int gain[32];
-		int idepth = 0;
-		int sideToMove = pos.sideToMove ^ 1;
+		if (getMoveEnpassant(move))
+			occupied ^= 1ULL << (pos.sideToMove == Colors::white ? to + 8 : to - 8);
 
-		int fromSq = getMoveSource(move);
-		int toSq = getMoveTarget(move);
-		int attacker = getMovePiece(move);
+		U64 diagonal = Bitboards::bitboards[Piece::B] | Bitboards::bitboards[Piece::b] | Bitboards::bitboards[Piece::Q] | Bitboards::bitboards[Piece::q];
+		U64 straight = Bitboards::bitboards[Piece::R] | Bitboards::bitboards[Piece::r] | Bitboards::bitboards[Piece::Q] | Bitboards::bitboards[Piece::q];
 
-		int startPiece = Piece::P;
-		int endPiece = Piece::K;
-		int target = -1;
+		U64 attackers = pos.attackersTo(to, occupied);
+		int side = pos.sideToMove;
+		bool result = true;
 
-		if (sideToMove == Colors::black) {
-			startPiece = Piece::p;
-			endPiece = Piece::k;
-		}
+		while (true) {
+			side ^= 1;
+			attackers &= occupied;
 
-		for (int piece = startPiece; piece <= endPiece; piece++) {
-			if (getBit(Bitboards::bitboards[piece], toSq)) {
-				target = piece;
-				break;
+			U64 sideAttackers = attackers & Bitboards::occupancies[side];
+			if (!sideAttackers) break;
+
+			result = !result;
+
+			int first = (side == Colors::white) ? Piece::P : Piece::p;
+			int piece = first;
+			U64 bb = 0;
+
+			for (; piece < first + 5; piece++) {
+				if ((bb = sideAttackers & Bitboards::bitboards[piece])) break;
 			}
-		}
 
-		if (target < 0) return 0;
+			// only the king is left, it may recapture only if the square is no longer defended
+			if (piece == first + 5)
+				return (attackers & ~Bitboards::occupancies[side]) ? !result : result;
 
-		U64 seen = 0ULL;
-		U64 occupied = Bitboards::occupancies[Colors::both];
-		U64 attackerBB = 1ULL << fromSq;
+			swap = pieceValues[piece] - swap;
+			if (swap < static_cast<int>(result)) break;
 
-		U64 attadef = pos.attackersTo(toSq, occupied);
-		U64 maxXray = occupied & ~(Bitboards::bitboards[Piece::N] | Bitboards::bitboards[Piece::K] | Bitboards::bitboards[Piece::n] | Bitboards::bitboards[Piece::k]);
+			occupied ^= bb & (0 - bb);
 
-		gain[idepth] = pieceValues[target];
+			int type = piece - first;
 
-		while (attackerBB) {
-			idepth++;
-			gain[idepth] = pieceValues[attacker] - gain[idepth - 1];
+			if (type == Piece::P || type == Piece::B || type == Piece::Q)
+				attackers |= Magic::getBishopAttacks(to, occupied) & diagonal;
 
-			if (std::max(-gain[idepth - 1], gain[idepth]) < 0) {
-				break;
+			if (type == Piece::R || type == Piece::Q)
+				attackers |= Magic::getRookAttacks(to, occupied) & straight;
+		}
+
+		return result;
+	}
+
+	static const int BAD_CAPTURE_OFFSET = 30000;
+
+	// scores every move once, the picker below does the ordering lazily
+	static void scoreMoves(Movegen::MoveList* moveList, int* moveScores, int bestMove, Position& pos) {
+		PHASE_TIMER(MoveOrdering);
+
+		for (int i = 0; i < moveList->count; i++) {
+			if (bestMove == moveList->moves[i]) {
+				moveScores[i] = 30000;
+			} else {
+				moveScores[i] = Search::scoreMove(moveList->moves[i], pos);
 			}
+		}
+	}
+
+	/*
+		Move picker: selection sort step that brings the best remaining move to index current. Most nodes cut off
+		after a move or two, so sorting the whole list up front is mostly wasted. Captures are only checked with
+		SEE once they come up; a losing capture drops below the quiet moves and the next best move is picked.
+	*/
+	static void pickMove(Movegen::MoveList* moveList, int* moveScores, int current, Position& pos) {
+		PHASE_TIMER(MoveOrdering);
 
-			attadef &= ~attackerBB;
-			occupied &= ~attackerBB;
-			seen |= attackerBB;
+		while (true) {
+			int best = current;
 
-			if ((attackerBB & maxXray) != 0) {
-				attadef = considerXrays(toSq, occupied) & ~seen;
+			for (int i = current + 1; i < moveList->count; i++) {
+				if (moveScores[i] > moveScores[best]) best = i;
 			}
 
-			attackerBB = minAttacker(attadef, sideToMove, attacker);
-			sideToMove ^= 1;
-		}
+			std::swap(moveList->moves[current], moveList->moves[best]);
+			std::swap(moveScores[current], moveScores[best]);
 
-		for (idepth--; idepth > 0; idepth--) {
-			gain[idepth - 1] = -std::max(-gain[idepth - 1], gain[idepth]);
-		}
+			int move = moveList->moves[current];
 
-		return gain[0];
+			// hash and PV moves are never demoted, bad captures are already classified
+			if (!getMoveCapture(move) || moveScores[current] < 0 || moveScores[current] >= 20000) return;
+
+			if (seeGE(move, pos, 0)) return;
+
+			moveScores[current] -= BAD_CAPTURE_OFFSET;
+		}
 	}
 
-	static int quiescence(int alpha, int beta, Position& pos) {
+	/*
+		Quiescence search
+
+		depth is 0 at the first qsearch ply and negative below it. With QSearchChecks on, quiet moves that give check
+		are searched at the first ply as well, so mates and forks that start with a check are not missed at the horizon.
+		They cost a full move generation per qsearch root, which is why they are off by default. In check there
+		is no stand pat, every evasion is searched and running out of them is mate. Captures that cannot lift the
+		stand pat score anywhere near alpha are skipped without making them (delta pruning).
+		PV nodes take neither TT cutoffs nor delta pruning, like negamax they keep the exact line.
+	*/
+	template <Search::NodeType nodeType>
+	static int quiescence(int alpha, int beta, Position& pos, int depth = 0) {
+		constexpr bool pvNode = nodeType != Search::NonPV;
+
 		bool ttHit;
 		int bestMove = 0;
-		HASHE* ttEntry = readHashEntry(alpha, beta, &bestMove, 0, pos, &ttHit);
+		HASHE* ttEntry = readHashEntry(alpha, beta, &bestMove, 0, pos.hashKey, &ttHit);
+
+		SEARCH_STAT(Search::stats.ttProbes++; Search::stats.ttHits += ttHit);
 
 		int ttMove = 0;
 		int ttEval = EVAL_UNKNOWN;
@@ -346,33 +571,74 @@ namespace Sloth {
 
 		if (ttHit) {
 			ttMove = ttEntry->bestMove;
-			ttEval = ttEntry->score;
+			ttEval = scoreFromTT(ttEntry->score);
 			ttFlag = ttEntry->flag;
 			ttDepth = ttEntry->depth;
 		}
 
-		if (ttDepth >= 0 && ttEval != EVAL_UNKNOWN && ((ttFlag == hashfALPHA && ttEval <= alpha) || (ttFlag == hashfBETA && ttEval >= beta) || (ttFlag == hashfEXACT))) {
+		if (!pvNode && ttDepth >= 0 && ttEval != EVAL_UNKNOWN && ((ttFlag == hashfALPHA && ttEval <= alpha) || (ttFlag == hashfBETA && ttEval >= beta) || (ttFlag == hashfEXACT))) {
+			SEARCH_STAT(Search::stats.ttCutoffs++);
 			return ttEval;
 		}
 
 		if ((nodes & 2047) == 0) pos.time.communicate();
 
 		nodes++;
+		SEARCH_STAT(Search::stats.qsearchNodes++);
 
 		if (Search::ply > MAX_PLY - 1) return Eval::evaluate(pos);
 
-		int eval = Eval::evaluate(pos);
+		int kingCheck = pos.isSquareAttacked(Bitboards::getLs1bIndex(Bitboards::bitboards[(pos.sideToMove == Colors::white) ? Piece::K : Piece::k]), pos.sideToMove ^ 1);
+
+		int eval = -VALUE_INFINITE;
+		int bestScore = -VALUE_INFINITE;
+		int hashFlag = hashfALPHA;
 
-		if (eval >= beta) return beta;
-		if (eval > alpha) alpha = eval;
+		if (!kingCheck) {
+			eval = Eval::evaluate(pos);
+			bestScore = eval;
+
+			if (eval >= beta) return eval;
+			if (eval > alpha) alpha = eval;
+		}
+
+		bool quietChecks = Search::qsearchChecks && !kingCheck && depth == 0;
+
+		// the move made here is what the counter move and continuation histories of the next ply look back at
+		Search::SearchStack* currentSS = &ss[Search::ply];
 
 		Movegen::MoveList moveList[1];
-		Movegen::generateMoves(pos, moveList, true);
-		Search::sortMoves(moveList, 0, pos);
+		Movegen::generateMoves(pos, moveList, !kingCheck && !quietChecks);
+		Search::sortMoves(moveList, bestMove, pos);
+
+		// outside of check only the quiet moves that give check are searched, they are picked before being made
+		CheckInfo checkInfo;
+		if (quietChecks) pos.checkInfo(checkInfo);
+
+		int legalMoves = 0;
+		bestMove = 0;
 
 		for (int c = 0; c < moveList->count; c++) {
-			if (see(moveList->moves[c], pos) < -83) {
-				continue;
+			const int move = moveList->moves[c];
+			bool capture = getMoveCapture(move);
+
+			if (!kingCheck) {
+				if (capture || getMovePromotion(move)) {
+					// delta pruning, even winning the captured piece for free leaves the score below alpha
+					if (!pvNode && !getMovePromotion(move)) {
+						int deltaScore = eval + pieceValues[capturedPiece(move)] + 200;
+
+						if (deltaScore <= alpha) {
+							bestScore = std::max(bestScore, deltaScore);
+							continue;
+						}
+					}
+
+					if (!seeGE(move, pos, -83))
+						continue;
+				} else if (!quietChecks || !pos.givesCheck(move, checkInfo)) {
+					continue;
+				}
 			}
 
 			copyBoard(pos);
@@ -380,56 +646,91 @@ namespace Sloth {
 			Search::repetitionIndex++;
 			Search::repetitionTable[Search::repetitionIndex] = pos.hashKey;
 
-			if (pos.makeMove(pos, moveList->moves[c], captures) == 0) {
+			if (pos.makeMove(pos, move, allMoves) == 0) {
 				Search::ply--;
 				Search::repetitionIndex--;
 				continue;
 			}
 
-			int score = -quiescence(-beta, -alpha, pos);
+			legalMoves++;
+
+			currentSS->move = move;
+			currentSS->movedPiece = getMovePiece(move);
+
+			int score = -quiescence<nodeType>(-beta, -alpha, pos, depth - 1);
 			Search::ply--;
 			Search::repetitionIndex--;
 			takeBack(pos);
 
 			if (pos.time.stopped == true) return 0;
 
-			if (score > alpha) {
-				alpha = score;
+			if (score > bestScore) {
+				bestScore = score;
 
-				if (score >= beta) {
-					return beta;
+				if (score > alpha) {
+					alpha = score;
+					bestMove = move;
+					hashFlag = hashfEXACT;
+
+					if (score >= beta) {
+						writeQsearchEntry(score, bestMove, hashfBETA, pos.hashKey);
+
+						return score;
+					}
 				}
 			}
 		}
 
-		return alpha;
-	}
+		// every evasion was tried (they are never pruned), so none was legal
+		if (kingCheck && legalMoves == 0) return -MATE_VALUE + Search::ply;
 
-	static Search::SearchStack ss[MAX_PLY];
+		writeQsearchEntry(bestScore, bestMove, hashFlag, pos.hashKey);
 
+		return bestScore;
+	}
 
+	/*
+		The node type is fixed by the caller: the root, the first move and full window re-searches of a PV node are
+		PV nodes, every null window search is a NonPV node. That matches beta - alpha > 1 exactly, since a PV node
+		never gets a null window and a NonPV node never gets anything else.
+	*/
+	template <Search::NodeType nodeType>
 	int Search::negamax(int alpha, int beta, int depth, bool cutnode, Position& pos) {
+		constexpr bool pvNode = nodeType != NonPV;
+		constexpr bool rootNode = nodeType == Root;
+		constexpr NodeType qsNodeType = pvNode ? PV : NonPV;
 
 		SearchStack* currentSS = &ss[Search::ply];
 
 		pvLength[Search::ply] = Search::ply; // inits the PV length
 
-		// set aging factor to 0.98 if time remaining is less than 5 seconds
-		if (pos.time.getTimeMs() - pos.time.startTime < 5000)
-			agingFactor = 0.98;
-
 		int score = 0;
+		int bestScore = -VALUE_INFINITE;
 		int bestMove = 0;
 		int hashFlag = hashfALPHA;
 
-		bool pvNode = beta - alpha > 1;
-		bool isRoot = (Search::ply == 0);
+		if (!rootNode) {
+			int end = repetitionWindow(pos);
+
+			if (isRepetition(pos, end) || pos.fifty >= 100) return 0; // draw score, repetition has occured
+
+			// a draw is one move away, so this node is worth at least the draw score
+			if (alpha < 0 && hasUpcomingRepetition(pos, end)) {
+				alpha = 0;
 
-		if (Search::ply && (isRepetition(pos) || pos.fifty >= 100)) return 0; // draw score, repetition has occured
+				if (alpha >= beta) return alpha;
+			}
+		}
+
+		int excludedMove = currentSS->excludedMove;
+		U64 ttKey = pos.hashKey ^ exclusionKey(excludedMove);
 
 		bool ttHit;
 
-		HASHE* ttEntry = readHashEntry(alpha, beta, &bestMove, depth, pos, &ttHit);
+		// probe at any depth, the cutoff below checks the entry depth itself and singular extensions want shallower entries too
+		HASHE* ttEntry = readHashEntry(alpha, beta, &bestMove, 0, ttKey, &ttHit);
+
+		SEARCH_STAT(Search::stats.ttProbes++; Search::stats.ttHits += ttHit);
 
 		int ttMove = 0;
 		int ttEval = EVAL_UNKNOWN;
@@ -438,37 +739,24 @@ namespace Sloth {
 
 		if (ttHit) {
 			ttMove = ttEntry->bestMove;
-			ttEval = ttEntry->score;
+			ttEval = scoreFromTT(ttEntry->score);
 			ttFlag = ttEntry->flag;
 			ttDepth = ttEntry->depth;
 		}
 
 		if (!pvNode && ttDepth >= depth && ttEval != EVAL_UNKNOWN && ((ttFlag == hashfALPHA && ttEval <= alpha) || (ttFlag == hashfBETA && ttEval >= beta) || (ttFlag == hashfEXACT))) {
+			SEARCH_STAT(Search::stats.ttCutoffs++);
 			return ttEval;
 		}
 
 		if ((nodes & 2047) == 0) pos.time.communicate();
 
-		// age
-		if ((nodes & 1000) == 0) {
-			for (int i = 0; i < MAX_PLY; i++) {
-				killerMoves[0][i] *= agingFactor;
-				killerMoves[1][i] *= agingFactor;
-			}
-
-			for (int i = 0; i < 12; i++) {
-				for (int j = 0; j < 64; j++) {
-					historyMoves[i][j] *= agingFactor;
-				}
-			}
-		}
-
-		if (isRoot) {
+		if (rootNode) {
 			lastCurrmoveOutput = pos.time.startTime - CURRMOVE_INTERVAL;
 		}
 
 		// recursion escape condition
-		if (depth == 0) return quiescence(alpha, beta, pos);
+		if (depth == 0) return quiescence<qsNodeType>(alpha, beta, pos);
 
 		// preventing overflow of arrays
 		if (Search::ply > MAX_PLY - 1) return Eval::evaluate(pos);
@@ -495,23 +783,28 @@ namespace Sloth {
 			}
 		}	
 
-		if (ply && !pvNode && depth < 2 && (staticEval + 339) <= alpha) return quiescence(alpha, beta, pos);
+		if (!pvNode && depth < 2 && (staticEval + 339) <= alpha) {
+			SEARCH_STAT(Search::stats.razorings++);
+			return quiescence<NonPV>(alpha, beta, pos);
+		}
 
 		if (depth < 3 && !pvNode && !kingCheck && abs(beta - 1) > -VALUE_INFINITE + 100) {
 			int evalMargin = 120 * depth;
 
 			if (staticEval - evalMargin >= beta) {
+				SEARCH_STAT(Search::stats.reverseFutilityCutoffs++);
 				return staticEval - evalMargin;
 			}
 		}
 
 		// New beta pruning
 		if (!pvNode && !kingCheck && depth <= 8 && staticEval - 65 * std::max(0, (depth - improving)) >= beta) {
+			SEARCH_STAT(Search::stats.reverseFutilityCutoffs++);
 			return staticEval;
 		}
 
 		// null move pruning
-		if (depth >= 3 && !kingCheck && Search::ply && !Eval::isEndgame()) {
+		if (depth >= 3 && !kingCheck && !rootNode && !excludedMove && !Eval::isEndgame()) {
 			copyBoard(pos);
 
 			Search::ply++;
@@ -519,6 +812,8 @@ namespace Sloth {
 			Search::repetitionIndex++;
 			Search::repetitionTable[Search::repetitionIndex] = pos.hashKey;
 
+			currentSS->move = 0;
+
 			if (pos.enPassant != no_sq) // hash enpassant if available
 				pos.hashKey ^= Zobrist::enPassantKeys[pos.enPassant];
 
@@ -526,7 +821,9 @@ namespace Sloth {
 			pos.sideToMove ^= 1; // switching the side gives the opponent an extra move to make
 			pos.hashKey ^= Zobrist::sideKey;
 
-			score = -negamax(-beta, -beta + 1, depth - 2 - (depth >= 8 ? 3 : 2), !cutnode, pos);
+			SEARCH_STAT(Search::stats.nullMoveSearches++);
+
+			score = -negamax<NonPV>(-beta, -beta + 1, depth - 2 - (depth >= 8 ? 3 : 2), !cutnode, pos);
 
 			Search::ply--;
 			Search::repetitionIndex--;
@@ -535,21 +832,28 @@ namespace Sloth {
 
 			if (pos.time.stopped == true) return 0; // returns 0 if time is up
 
-			// fail hard beta cutoff
 			if (score >= beta) {
-				// store hash entry
-				writeHashEntry(beta, bestMove, depth, hashfBETA, pos);
+				SEARCH_STAT(Search::stats.nullMoveCutoffs++);
+
+				if (score >= MATE_SCORE) score = beta; // the null move can not prove a mate
+
+				writeHashEntry(score, bestMove, depth, hashfBETA, ttKey);
 
-				return beta;
+				return score;
 			}
 		}
 
 		bool canFutilityPrune = false;
 
-		if (ply && !pvNode && (depth <= 8)) {
+		if (!pvNode && (depth <= 8)) {
 			if ((staticEval + (168 * depth)) <= alpha) canFutilityPrune = true;
 		}
 
+		// only futility pruning asks whether a quiet move gives check
+		CheckInfo checkInfo;
+
+		if (canFutilityPrune) pos.checkInfo(checkInfo);
+
 		if (!pvNode && !kingCheck && depth <= 5) {
 			score = staticEval + 125;
 
@@ -557,7 +861,7 @@ namespace Sloth {
 				int newScore;
 
 				if (depth == 1) {
-					newScore = quiescence(alpha, beta, pos);
+					newScore = quiescence<NonPV>(alpha, beta, pos);
 
 					return (newScore > score) ? newScore : score;
 				}
@@ -565,7 +869,7 @@ namespace Sloth {
 				score += 175;
 
 				if (score < beta && depth <= 2) {
-					newScore = quiescence(alpha, beta, pos);
+					newScore = quiescence<NonPV>(alpha, beta, pos);
 
 					if (newScore < beta) {
 						return (newScore > score) ? newScore : score;
@@ -577,7 +881,7 @@ namespace Sloth {
 		// ProbCut
 		int probCutBeta = std::min(beta + 227, MATE_VALUE - MAX_PLY - 1);
 
-		if (depth >= 6 && !pvNode && !kingCheck && ply > 0 && !(ttDepth >= depth - 3 && ttEval != EVAL_UNKNOWN && ttEval < probCutBeta)) {
+		if (depth >= 6 && !pvNode && !kingCheck && !excludedMove && !(ttDepth >= depth - 3 && ttEval != EVAL_UNKNOWN && ttEval < probCutBeta)) {
 			int probCutBeta = beta + 172;
 			int reducedDepth = depth - 4;
 
@@ -590,7 +894,7 @@ namespace Sloth {
 
 				if (pos.time.stopped) return 0;
 
-				if (see(captureList->moves[c], pos) < 0) {
+				if (!seeGE(captureList->moves[c], pos, 0)) {
 					continue;
 				}
 
@@ -609,10 +913,15 @@ namespace Sloth {
 					continue; // skip to next move
 				}
 
-				score = -quiescence(-probCutBeta, -probCutBeta + 1, pos);
+				currentSS->move = captureList->moves[c];
+				currentSS->movedPiece = getMovePiece(captureList->moves[c]);
+
+				SEARCH_STAT(Search::stats.probCutSearches++);
+
+				score = -quiescence<NonPV>(-probCutBeta, -probCutBeta + 1, pos);
 
 				if (score >= probCutBeta) {
-					score = -negamax(-probCutBeta, -probCutBeta + 1, reducedDepth, !cutnode, pos);
+					score = -negamax<NonPV>(-probCutBeta, -probCutBeta + 1, reducedDepth, !cutnode, pos);
 				}
 
 				Search::ply--;
@@ -621,13 +930,52 @@ namespace Sloth {
 				takeBack(pos);
 
 				if (score >= probCutBeta) {
-					writeHashEntry(score, captureList->moves[c], depth - 4, hashfBETA, pos);
+					SEARCH_STAT(Search::stats.probCutCutoffs++);
+
+					writeHashEntry(score, captureList->moves[c], depth - 4, hashfBETA, ttKey);
 
 					return score;
 				}
 			}
 		}
 
+		/*
+			Singular extensions
+
+			When the hash move holds a lower bound from a search nearly as deep as this one, search the node again at
+			reduced depth without it, against a bound a little below the hash score. If nothing else gets there the
+			hash move is singular and is extended by one ply. If the reduced search fails high even above beta, several
+			moves beat beta and the node is cut right away (multi-cut).
+		*/
+		int singularExtension = 0;
+
+		if (!rootNode && depth >= 8 && ttMove && !excludedMove && ttFlag != hashfALPHA && ttDepth >= depth - 3 && abs(ttEval) < MATE_SCORE) {
+			int singularBeta = ttEval - 3 * depth;
+
+			currentSS->excludedMove = ttMove;
+			score = negamax<NonPV>(singularBeta - 1, singularBeta, (depth - 1) / 2, cutnode, pos);
+			currentSS->excludedMove = 0;
+
+			pvLength[Search::ply] = Search::ply;
+
+			if (pos.time.stopped == true) return 0;
+
+			if (score < singularBeta)
+				singularExtension = 1;
+			else if (singularBeta >= beta)
+				return singularBeta;
+		}
+
+		/*
+			Internal iterative reductions
+
+			Without a hash move the move list is ordered by history alone, and a full depth search of a badly
+			ordered PV or cut node is the most expensive thing the search does. Search it one ply shallower
+			instead, the entry it leaves behind gives the next visit a hash move.
+		*/
+		if (Search::iirDepth && (pvNode || cutnode) && depth >= Search::iirDepth && !bestMove && !excludedMove)
+			depth--;
+
 		Movegen::MoveList moveList[1];
 		Movegen::generateMoves(pos, moveList, false);
 
@@ -635,15 +983,70 @@ namespace Sloth {
 			enablePVScoring(moveList);
 		}
 
-		sortMoves(moveList, bestMove, pos); // sort the moves
+		int moveScores[256];
+		scoreMoves(moveList, moveScores, bestMove, pos);
+
+		// the root follows the root move list instead, best move of the last pass first
+		if (rootNode) {
+			for (int i = 0; i < moveList->count; i++) {
+				RootMove* rootMove = findRootMove(moveList->moves[i]);
+
+				moveScores[i] = rootMove ? 20000 + static_cast<int>(Search::rootMoves.size() - (rootMove - Search::rootMoves.data())) : -1;
+			}
+		}
 
 		int movesSearched = 0;
+		bool ttCapture = bestMove && getMoveCapture(bestMove); // a capture as hash move makes the quiets less likely to matter
+
+		// moves searched without a cutoff, they receive a history malus when a later move fails high
+		int quietsSearched[64], capturesSearched[32];
+		int quietCount = 0, captureCount = 0;
 
 		for (int c = 0; c < moveList->count; c++) {
+			pickMove(moveList, moveScores, c, pos);
+
 			const int move = moveList->moves[c];
 
+			if (move == excludedMove) continue;
+
+			if (rootNode && !findRootMove(move)) continue; // searchmoves, or a line already taken by MultiPV
+
+			/*
+				Quiet move pruning, decided before the move is made. A pruned move still has to be counted as legal,
+				otherwise a node whose remaining moves were all pruned would look like mate or stalemate.
+			*/
+			if (movesSearched > 0 && !getMoveCapture(move)) {
+				bool prune = false;
+
+				// futility pruning on current move
+				if (canFutilityPrune && legalMoves > 0
+					&& (killerMoves[0][Search::ply] != move)
+					&& (killerMoves[1][Search::ply] != move)
+					&& (getMovePiece(move) != Piece::P && getMovePiece(move) != Piece::p)
+					&& !getMovePromotion(move)
+					&& !getMoveCastling(move)
+					&& !pos.givesCheck(move, checkInfo)) {
+					prune = true;
+					SEARCH_STAT(Search::stats.futilityPruned++);
+				}
+
+				// late move pruning
+				else if (!pvNode && depth <= 3 && !kingCheck && (legalMoves >= lmpMargins[depth])) {
+					prune = true;
+					SEARCH_STAT(Search::stats.lmpPruned++);
+				}
+
+				if (prune) {
+					if (pos.isLegal(move)) legalMoves++;
+
+					continue;
+				}
+			}
+
 			copyBoard(pos);
 
+			unsigned long long nodesBefore = nodes;
+
 			Search::ply++;
 			Search::repetitionIndex++;
 			Search::repetitionTable[Search::repetitionIndex] = pos.hashKey;
@@ -656,18 +1059,20 @@ namespace Sloth {
 				continue; // skip to next move
 			}
 
+			currentSS->move = move;
+			currentSS->movedPiece = getMovePiece(move);
+
 			reportedCurrMove = false;
 
-			if (isRoot && !reportedCurrMove) {
+			if (rootNode && !reportedCurrMove) {
 				int now = pos.time.getTimeMs();
 				int elapsed = now - pos.time.startTime;
 				int elapsedSinceLast = now - lastCurrmoveOutput;
 
 				if (elapsed >= CURRMOVE_INITIAL_DELAY && elapsedSinceLast >= CURRMOVE_INTERVAL) {
-                printf("info depth %d currmove %s currmovenumber %d\n",
-                depth,
-                Movegen::moveToString(move).c_str(),
-                c + 1);
+					char moveString[6];
+
+					printf("info depth %d currmove %s currmovenumber %d\n", depth, Movegen::moveToString(move, moveString), c + 1);
 
 					lastCurrmoveOutput = now;
 					reportedCurrMove = true;
@@ -676,54 +1081,46 @@ namespace Sloth {
 
 			legalMoves++;
 
+			int newDepth = depth - 1 + ((move == ttMove) ? singularExtension : 0);
+
 			if (movesSearched == 0) {
-				score = -negamax(-beta, -alpha, depth - 1, !cutnode, pos); // doing the normal AB search
+				score = -negamax<pvNode ? PV : NonPV>(-beta, -alpha, newDepth, !cutnode, pos); // doing the normal AB search
 			}
 			else {
-				// futility pruning on current move
+				int R = 0;
+
+				// LMR
+				if (movesSearched > 1 && depth >= reductionLimit && kingCheck == 0 && getMoveCapture(move) == 0 && getMovePromotion(move) == 0) {
+					R = reductions[std::min(depth, MAX_PLY - 1)][std::min(movesSearched, 63)];
 
-				if (canFutilityPrune && (legalMoves > 1)) {
-					if (!pos.isSquareAttacked(Bitboards::getLs1bIndex(Bitboards::bitboards[(pos.sideToMove == Colors::white) ? Piece::K : Piece::k]), pos.sideToMove ^ 1)
-						&& (killerMoves[0][ply] != move)
-						&& (killerMoves[1][ply] != move)
-						&& (getMovePiece(move) != Piece::P && getMovePiece(move) != Piece::p)
-						&& !getMovePromotion(move)
-						&& !getMoveCastling(move) && !getMoveCapture(move)) {
+					if (pvNode) R--;
+					if (!improving) R++;
+					if (cutnode) R++;
+					if (ttCapture) R++;
+					if (move == killerMoves[0][Search::ply - 1] || move == killerMoves[1][Search::ply - 1]) R--; // the move is made, the killers are the parent's
 
-						repetitionIndex--;
-						ply--;
-						takeBack(pos);
+					R -= quietHistoryScore(move, Search::ply - 1) / 12288; // read at the parent, where the move was made
 
-						continue;
-					}
+					R = clamp(R, 0, depth - 2);
 				}
 
-				// late move pruning
-				if (ply && !pvNode && depth <= 3 && !kingCheck && !getMoveCapture(move) && (legalMoves > lmpMargins[depth])) {
-					repetitionIndex--;
-					ply--;
-					takeBack(pos);
+				if (R > 0) {
+					SEARCH_STAT(Search::stats.lmrSearches++);
 
-					continue;
-				}
+					score = -negamax<NonPV>(-alpha - 1, -alpha, newDepth - R, true, pos);
 
-				// LMR
-				if (movesSearched > 1 && depth >= reductionLimit && kingCheck == 0 && getMoveCapture(move) == 0 && getMovePromotion(move) == 0) {
-					int R = 1 + depth / 4;
-					if (pvNode) R--;
-					if (move == killerMoves[0][ply] || move == killerMoves[1][ply]) R = std::max(1, R - 1);
-					score = -negamax(-alpha - 1, -alpha, depth - 1 - std::max(0, R), true, pos);
+					SEARCH_STAT(if (score > alpha) Search::stats.lmrResearches++);
 				}
 				else
 					score = alpha + 1;
 
 				// principle variation search
 				if (score > alpha) {
-					score = -negamax(-alpha - 1, -alpha, depth - 1, false, pos); // better move has been found during LMR, re-search at full depth but with narrowed score bandwith
+					score = -negamax<NonPV>(-alpha - 1, -alpha, newDepth, !cutnode, pos); // better move has been found during LMR, re-search at full depth but with narrowed score bandwith
 
 					// if fails to prove that other moves are bad
-					if ((score > alpha) && (score < beta)) { // if LMR fails, re-search at full depth and full score bandwith
-						score = -negamax(-beta, -alpha, depth - 1, !cutnode, pos);
+					if (pvNode && (score > alpha) && (score < beta)) { // if LMR fails, re-search at full depth and full score bandwith
+						score = -negamax<PV>(-beta, -alpha, newDepth, !cutnode, pos);
 					}
 				}
 			}
@@ -737,13 +1134,33 @@ namespace Sloth {
 
 			movesSearched++;
 
+			// the first move and every move that raised alpha have an exact score or a bound worth keeping
+			if (rootNode) {
+				RootMove* rootMove = findRootMove(move);
+
+				rootMove->nodes += nodes - nodesBefore;
+
+				if (movesSearched == 1 || score > alpha) {
+					rootMove->score = score;
+					rootMove->pv[0] = move;
+
+					for (int next = 1; next < pvLength[1]; next++)
+						rootMove->pv[next] = pvTable[1][next];
+
+					rootMove->pvLength = std::max(pvLength[1], 1);
+				} else {
+					rootMove->score = -VALUE_INFINITE;
+				}
+			}
+
+			if (score > bestScore) bestScore = score;
+
 			// if better move is found
 			if (score > alpha) {
 				// switch hash flag
 				hashFlag = hashfEXACT;
 				bestMove = move;
 
-				historyMoves[getMovePiece(move)][getMoveTarget(move)] += depth;
 				alpha = score; //PV node
 
 				pvTable[Search::ply][Search::ply] = move;
@@ -754,22 +1171,51 @@ namespace Sloth {
 
 				pvLength[Search::ply] = pvLength[Search::ply + 1];
 
-				// using fail-hard beta cutoff
+				// fail soft beta cutoff, the score is returned and stored as it is
 				if (score >= beta) {
-					// store hash entry
-					writeHashEntry(beta, bestMove, depth, hashfBETA, pos);
+					SEARCH_STAT(Search::stats.betaCutoffs++; Search::stats.firstMoveCutoffs += (movesSearched == 1));
+
+					// store hash entry, the root of a later MultiPV line would store a move that is not the best one
+					if (!rootNode || Search::pvIndex == 0)
+						writeHashEntry(score, bestMove, depth, hashfBETA, ttKey);
+
+					int bonus = historyBonus(depth);
 
 					if (getMoveCapture(move) == 0) {
-						killerMoves[1][Search::ply] = killerMoves[0][Search::ply];
-						killerMoves[0][Search::ply] = move;
+						if (killerMoves[0][Search::ply] != move) {
+							killerMoves[1][Search::ply] = killerMoves[0][Search::ply];
+							killerMoves[0][Search::ply] = move;
+						}
+
+						if (ss[Search::ply - 1].move)
+							counterMoves[ss[Search::ply - 1].movedPiece][getMoveTarget(ss[Search::ply - 1].move)] = move;
+
+						updateQuietHistories(move, bonus);
+
+						for (int i = 0; i < quietCount; i++)
+							updateQuietHistories(quietsSearched[i], -bonus);
+					} else {
+						updateHistory(captureHistoryEntry(move), bonus);
 					}
 
-					return beta;
+					// captures that were tried first and failed to cut are always punished
+					for (int i = 0; i < captureCount; i++)
+						updateHistory(captureHistoryEntry(capturesSearched[i]), -bonus);
+
+					return score;
 				}
 			}
+
+			if (getMoveCapture(move)) {
+				if (captureCount < 32) capturesSearched[captureCount++] = move;
+			} else if (quietCount < 64) {
+				quietsSearched[quietCount++] = move;
+			}
 		}
 
 		if (legalMoves == 0) {
+			if (excludedMove) return alpha; // only the hash move was legal, it is singular by definition
+
 			if (kingCheck) {
 				return -MATE_VALUE + Search::ply;
 			}
@@ -778,14 +1224,48 @@ namespace Sloth {
 			}
 		}
 
-		writeHashEntry(alpha, bestMove, depth, hashFlag, pos);
+		// fail low returns the best score found, a tighter upper bound than alpha
+		if (!rootNode || Search::pvIndex == 0)
+			writeHashEntry(bestScore, bestMove, depth, hashFlag, ttKey);
 
-		return alpha; // move fails low
+		return bestScore;
 	}
 	
+	/*
+		Insertion sort by score. It is stable, so moves that failed low and moves left unsearched by a stop keep
+		the order of the last pass, and unlike std::stable_sort it needs no temporary buffer from the heap.
+		The list is nearly sorted after every pass, so this stays close to linear.
+	*/
+	static void sortRootMoves(Search::RootMove* first, Search::RootMove* last) {
+		for (Search::RootMove* i = first + 1; i < last; i++) {
+			if (i->score <= (i - 1)->score) continue;
+
+			Search::RootMove current = *i;
+			Search::RootMove* j = i;
+
+			for (; j > first && (j - 1)->score < current.score; j--)
+				*j = *(j - 1);
+
+			*j = current;
+		}
+	}
+
+	// runs the root search of the current line and sorts its moves by the new scores, the best one ends up at pvIndex
+	static int searchRoot(int alpha, int beta, int depth, Position& pos) {
+		for (size_t i = Search::pvIndex; i < Search::rootMoves.size(); i++)
+			Search::rootMoves[i].score = -VALUE_INFINITE;
+
+		int score = Search::negamax<Search::Root>(alpha, beta, depth, false, pos);
+
+		sortRootMoves(Search::rootMoves.data() + Search::pvIndex, Search::rootMoves.data() + Search::rootMoves.size());
+
+		return score;
+	}
+
 	static int aspirate(int depth, int score, Position& pos) {
-		if (depth == 1) {
-			return Search::negamax(-VALUE_INFINITE, VALUE_INFINITE, depth, false, pos);
+		// the first iteration, or a line that never got a score, has nothing to centre a window on
+		if (depth == 1 || score == -VALUE_INFINITE) {
+			return searchRoot(-VALUE_INFINITE, VALUE_INFINITE, depth, pos);
 		}
 
 		int delta = 50;
@@ -793,15 +1273,20 @@ namespace Sloth {
 		int beta = std::min(score + delta, VALUE_INFINITE);
 
 		for (;; delta += delta / 2) {
-			score = Search::negamax(alpha, beta, depth, false, pos);
+			score = searchRoot(alpha, beta, depth, pos);
+
+			if (pos.time.stopped) return score;
+
+			SEARCH_STAT(if (score <= alpha || score >= beta) Search::stats.aspirationResearches++);
 
+			// the fail soft score tells how far outside the window the result is, the new window opens from there
 			if (score <= alpha) {
 				beta = (alpha + beta) / 2;
-				alpha = std::max(alpha - delta, -VALUE_INFINITE);
+				alpha = std::max(score - delta, -VALUE_INFINITE);
 			}
 			else if (score >= beta) {
 				alpha = (alpha + beta) / 2;
-				beta = std::min(beta + delta, VALUE_INFINITE);
+				beta = std::min(score + delta, VALUE_INFINITE);
 			}
 			else {
 				return score;
@@ -809,85 +1294,220 @@ namespace Sloth {
 		}
 	}
 
+	static void printLine(int line, int depth, const Search::RootMove& rootMove, Position& pos) {
+		int time = pos.time.getTimeMs() - pos.time.startTime;
+
+		if (time == 0) time = 1;
+
+		U64 nps = static_cast<U64>(nodes / (static_cast<double>(time) / 1000.0));
+
+		int hashfull = hashFull();
+		int score = rootMove.score;
+
+		printf("info depth %d ", depth);
+
+		if (Search::multiPV > 1) printf("multipv %d ", line + 1);
+
+		if (score > -MATE_VALUE && score < -MATE_SCORE) {
+			printf("score mate %d nodes %lld nps %lu hashfull %d time %d pv ", -(score + MATE_VALUE) / 2 - 1, nodes, nps, hashfull, time);
+		}
+		else if (score > MATE_SCORE && score < MATE_VALUE) {
+			printf("score mate %d nodes %lld nps %lu hashfull %d time %d pv ", (MATE_VALUE - score) / 2 + 1, nodes, nps, hashfull, time);
+		}
+		else
+			printf("score cp %d nodes %lld nps %lu hashfull %d time %d pv ", score, nodes, nps, hashfull, time);
+
+		for (int c = 0; c < rootMove.pvLength; c++) {
+			Movegen::printMove(rootMove.pv[c]);
+			printf(" ");
+		}
+
+		printf("\n");
+	}
+
+	// legal moves of the root position, limited to the searchmoves list when one was given
+	static void initRootMoves(Position& pos) {
+		Movegen::MoveList moveList[1];
+		Movegen::generateMoves(pos, moveList, false);
+
+		// the first iteration has no scores yet, it starts from the usual move ordering
+		int hashMove = 0;
+		bool ttHit;
+		readHashEntry(-VALUE_INFINITE, VALUE_INFINITE, &hashMove, 0, pos.hashKey, &ttHit);
+
+		int moveScores[256];
+		scoreMoves(moveList, moveScores, hashMove, pos);
+
+		Search::rootMoves.clear();
+
+		for (int c = 0; c < moveList->count; c++) {
+			pickMove(moveList, moveScores, c, pos);
+
+			int move = moveList->moves[c];
+
+			if (!Search::searchMoves.empty() && std::find(Search::searchMoves.begin(), Search::searchMoves.end(), move) == Search::searchMoves.end())
+				continue;
+
+			if (!pos.isLegal(move)) continue;
+
+			Search::RootMove rootMove = {};
+			rootMove.move = move;
+			rootMove.score = -VALUE_INFINITE;
+			rootMove.previousScore = -VALUE_INFINITE;
+			rootMove.pvLength = 1;
+			rootMove.pv[0] = move;
+
+			Search::rootMoves.push_back(rootMove);
+		}
+	}
+
+#ifdef SEARCH_STATS
+	static double percent(unsigned long long part, unsigned long long total) {
+		return total ? 100.0 * part / total : 0.0;
+	}
+#endif
+
+	void Search::printStats() {
+#ifdef SEARCH_STATS
+		const SearchStats& st = Search::stats;
+
+		printf("info string nodes %llu qsearch %.1f%%\n", st.nodes, percent(st.qsearchNodes, st.nodes));
+		printf("info string tt probes %llu hits %.1f%% cutoffs %.1f%%\n", st.ttProbes, percent(st.ttHits, st.ttProbes), percent(st.ttCutoffs, st.ttProbes));
+		printf("info string beta cutoffs %llu first move %.1f%%\n", st.betaCutoffs, percent(st.firstMoveCutoffs, st.betaCutoffs));
+		printf("info string razoring %llu reverse futility %llu futility %llu lmp %llu\n", st.razorings, st.reverseFutilityCutoffs, st.futilityPruned, st.lmpPruned);
+		printf("info string null move %llu cutoffs %.1f%% probcut %llu cutoffs %.1f%%\n", st.nullMoveSearches, percent(st.nullMoveCutoffs, st.nullMoveSearches), st.probCutSearches, percent(st.probCutCutoffs, st.probCutSearches));
+		printf("info string lmr %llu re-searches %.1f%% aspiration re-searches %llu\n", st.lmrSearches, percent(st.lmrResearches, st.lmrSearches), st.aspirationResearches);
+
+		// effective branching factor: nodes of an iteration over the nodes of the one before it
+		printf("info string ebf");
+
+		for (int d = 2; d <= st.depth; d++) {
+			if (st.iterationNodes[d - 1])
+				printf(" %d:%.2f", d, static_cast<double>(st.iterationNodes[d]) / st.iterationNodes[d - 1]);
+		}
+
+		printf("\n");
+#else
+		printf("info string search statistics are not compiled in, build with -DSEARCH_STATS\n");
+#endif
+	}
+
 	void Search::search(Position& pos, int depth, bool ponder) {
-		int score = 0;
+		// the search path goes on top of the game history, make sure it fits
+		if (static_cast<int>(Search::repetitionTable.size()) < Search::repetitionIndex + MAX_PLY + 2)
+			Search::repetitionTable.resize(Search::repetitionIndex + MAX_PLY + 2);
 
 		// clear out garbage
 		nodes = 0;
+		memset(&Search::stats, 0, sizeof(Search::stats));
 
 		pos.time.stopped = false;
 		pos.time.ponder = ponder;
 
-		agingFactor = 0.9;
-
 		followPV = 0;
 		scorePV = 0;
 
-		memset(killerMoves, 0, sizeof(killerMoves));
+		memset(killerMoves, 0, 2 * sizeof(*killerMoves));
 		memset(historyMoves, 0, sizeof(historyMoves));
-		memset(pvTable, 0, sizeof(pvTable));
-		memset(pvLength, 0, sizeof(pvLength));
+		memset(captureHistory, 0, sizeof(captureHistory));
+		memset(counterMoves, 0, sizeof(counterMoves));
+		memset(continuationHistory, 0, sizeof(continuationHistory));
+		memset(pvTable, 0, STACK_PLIES * sizeof(*pvTable));
+		memset(pvLength, 0, STACK_PLIES * sizeof(int));
 
-		memset(ss, 0, sizeof(ss));
+		memset(searchStack, 0, (STACK_PLIES + 2) * sizeof(Search::SearchStack));
 
-		int alpha = -VALUE_INFINITE;
-		int beta = VALUE_INFINITE;
+		initRootMoves(pos);
 
-		// iterative deepening
-		for (int curDepth = 1; curDepth <= depth; curDepth++) {
-			if (pos.time.stopped) break; // if time is up then stop calculating and return best move so far
+		int lines = std::min(Search::multiPV, static_cast<int>(Search::rootMoves.size()));
 
-			followPV = 1;
+		// everything the search needs is in place, from here on it must not touch the heap
+		AllocGuard::beginSearch();
 
-			score = aspirate(curDepth, score, pos);
+		/*
+			Iterative deepening with MultiPV
 
-			if ((score <= alpha) || (score >= beta)) {
-				alpha = -VALUE_INFINITE;
-				beta = VALUE_INFINITE;
-				continue;
+			Every iteration searches the lines one after the other. Line n searches the root without the best
+			moves of lines 1 to n-1, so its best move is the n-th best of the position, and all lines share one
+			table and one set of histories instead of paying for separate searches.
+		*/
+		for (int curDepth = 1; curDepth <= depth; curDepth++) {
+			if (pos.time.stopped || !lines) break; // if time is up then stop calculating and return best move so far
+
+			for (Search::RootMove& rootMove : Search::rootMoves) {
+				rootMove.previousScore = rootMove.score;
+				rootMove.nodes = 0;
 			}
 
-			alpha = score - 50;
-			beta = score + 50;
+			unsigned long long iterationStart = nodes;
 
-			if (pvLength[0]) {
-				int time = pos.time.getTimeMs() - pos.time.startTime;
+			for (Search::pvIndex = 0; Search::pvIndex < lines; Search::pvIndex++) {
+				Search::RootMove& lineMove = Search::rootMoves[Search::pvIndex];
 
-				if (time == 0) time = 1;
+				// follow the previous PV of this line first
+				memset(pvTable[0], 0, sizeof(pvTable[0]));
+				memcpy(pvTable[0], lineMove.pv, lineMove.pvLength * sizeof(int));
 
-				U64 nps = static_cast<U64>(nodes / (static_cast<double>(time) / 1000.0));
+				followPV = 1;
 
-				int hashfull = hashFull();
+				aspirate(curDepth, lineMove.previousScore, pos);
 
-				if (score > -MATE_VALUE && score < -MATE_SCORE) {
-					printf("info depth %d score mate %d nodes %lld nps %lu hashfull %d time %d pv ", curDepth ,-(score + MATE_VALUE) / 2 - 1, nodes, nps, hashfull, time);
-				}
-				else if (score > MATE_SCORE && score < MATE_VALUE) {
-					printf("info depth %d score mate %d nodes %lld nps %lu hashfull %d time %d pv ", curDepth,(MATE_VALUE - score) / 2 + 1, nodes, nps, hashfull, time);
-				}
-				else
-					printf("info depth %d score cp %d nodes %lld nps %lu hashfull %d time %d pv ", curDepth, score, nodes, nps, hashfull, time);
+				if (pos.time.stopped) break;
 
+				// a later line can come back with a better score than the lines above it, keep them ranked
+				sortRootMoves(Search::rootMoves.data(), Search::rootMoves.data() + Search::pvIndex + 1);
+			}
 
-				for (int c = 0; c < pvLength[0]; c++) {
-					Movegen::printMove(pvTable[0][c]);
-					printf(" ");
-				}
+			if (pos.time.stopped) break;
 
-				printf("\n");
-			}
+			SEARCH_STAT(Search::stats.depth = curDepth; Search::stats.iterationNodes[curDepth] = nodes - iterationStart);
+
+			for (int line = 0; line < lines; line++)
+				printLine(line, curDepth, Search::rootMoves[line], pos);
+
+			/*
+				Soft time limit. An iteration that spent nearly all its nodes on the best move is unlikely to be
+				overturned by the next one, so the search stops early and keeps the time for later moves. When
+				the effort was spread over several moves the next iteration gets more of the allotted time.
+				A fixed movetime always uses all of it.
+			*/
+			if (pos.time.timeSet && !pos.time.ponder && pos.time.moveTime == -1) {
+				double bestMoveEffort = static_cast<double>(Search::rootMoves[0].nodes) / std::max(nodes - iterationStart, 1ULL);
+				int elapsed = pos.time.getTimeMs() - pos.time.startTime;
+				int allotted = pos.time.stopTime - pos.time.startTime;
 
-			if (ponder) {
-				if (curDepth > MAX_PLY) curDepth = MAX_PLY - 1;
+				if (elapsed > allotted * (1.5 - bestMoveEffort) / 2) break;
 			}
 		}
 
+		// a bestmove is not allowed while pondering, a search that ran out of depth waits for ponderhit or stop
+		while (pos.time.ponder && !pos.time.stopped && !pos.time.inputClosed) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			pos.time.readInput();
+		}
+
+		AllocGuard::endSearch();
+
+		Search::pvIndex = 0;
+		Search::stats.nodes = nodes;
+
+		SEARCH_STAT(Search::printStats());
+
+		if (Search::rootMoves.empty()) {
+			printf("bestmove 0000\n");
+			return;
+		}
+
+		const Search::RootMove& best = Search::rootMoves[0];
+
 		printf("bestmove ");
-		Movegen::printMove(pvTable[0][0]); // first element within PV table
+		Movegen::printMove(best.move);
 
-		printf(" ponder ");
-		Movegen::printMove(pvTable[0][1]);
+		if (best.pvLength > 1) {
+			printf(" ponder ");
+			Movegen::printMove(best.pv[1]);
+		}
 
 		printf("\n");
 	}
-}
\ No newline at end of file
+}
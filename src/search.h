@@ -2,6 +2,7 @@
 #define SEARCH_H_INCLUDED
 
 #include <cstdarg>
+#include <vector>
 
 #include "position.h"
 #include "types.h"
@@ -53,16 +54,74 @@ namespace Sloth {
 
     namespace Search {
 
+        // node types, so the search is compiled once per type and the PV and root only work drops out of the other nodes
+        enum NodeType { NonPV, PV, Root };
+
         struct SearchStack {
             int ply;
             int staticEval;
+            int move; // move made from this ply, 0 for a null move
+            int movedPiece;
+            int excludedMove; // hash move left out by the singular extension search of this ply
+        };
+
+        /*
+            Counters of the last search. Only the node count is always kept, the rest count in builds with
+            SEARCH_STATS defined (-DSEARCH_STATS), otherwise SEARCH_STAT compiles to nothing.
+            Each search thread has its own copy.
+        */
+        struct SearchStats {
+            unsigned long long nodes;
+            unsigned long long qsearchNodes; // share of the nodes spent in quiescence
+            unsigned long long lmrSearches; // reduced late move searches
+            unsigned long long lmrResearches; // reduced searches that beat alpha and had to be searched again at full depth
+            unsigned long long aspirationResearches; // root searches repeated with a wider window after failing low or high
+
+            unsigned long long ttProbes, ttHits, ttCutoffs;
+            unsigned long long betaCutoffs, firstMoveCutoffs; // fail highs of the move loop, and how many came from the first move
+            unsigned long long razorings; // nodes resolved by a quiescence search at low depth
+            unsigned long long reverseFutilityCutoffs;
+            unsigned long long nullMoveSearches, nullMoveCutoffs;
+            unsigned long long probCutSearches, probCutCutoffs; // captures searched by ProbCut and the ones that cut
+            unsigned long long futilityPruned, lmpPruned; // quiet moves skipped without being made
+
+            int depth; // last completed iteration
+            unsigned long long iterationNodes[MAX_PLY + 1]; // nodes spent on each iteration, for the effective branching factor
         };
 
+#ifdef SEARCH_STATS
+#define SEARCH_STAT(statement) statement
+#else
+#define SEARCH_STAT(statement)
+#endif
+
+        extern thread_local SearchStats stats;
+
+        void printStats(); // dumps the counters of the last search as info strings
+
+        // a legal move at the root with the score and PV of its last search, the list is kept sorted best first
+        struct RootMove {
+            int move;
+            int score; // -VALUE_INFINITE until the move has been searched in the current pass, and for moves that failed low
+            int previousScore; // score of the previous iteration, the aspiration window of its line is centred on it
+            unsigned long long nodes; // size of its subtree in the current iteration
+            int pvLength;
+            int pv[MAX_PLY];
+        };
+
+        extern std::vector<RootMove> rootMoves;
+        extern std::vector<int> searchMoves; // restricts the root moves when not empty (go searchmoves)
+
+        extern int multiPV; // number of best lines searched and reported
+        extern int pvIndex; // line being searched, the root skips the moves of the lines above it
+
         extern int hashEntries;
 
         extern HASHE *hashTable;
 
-        extern U64 repetitionTable[1000];
+        // keys of the positions before the current one, game history first and then the search path
+        // grown when a position is set up, the search only needs MAX_PLY entries of headroom on top
+        extern std::vector<U64> repetitionTable;
         extern int repetitionIndex;
 
         extern int ply;
@@ -71,15 +130,22 @@ namespace Sloth {
 
         extern int contempt;
 
+        extern int iirDepth; // minimum depth for internal iterative reductions, 0 turns them off
+        extern bool qsearchChecks; // also search quiet checks at the first quiescence ply
+
         void clearHashTable();
         void initHashTable(int mb);
 
+        void initReductions();
+        void initStacks(); // per ply stacks, sized by MAX_PLY once at startup
+
         void printMoveScores(Movegen::MoveList* moveList, Position& pos);
 
         extern  int scoreMove(int move, Position& pos);
         extern  void sortMoves(Movegen::MoveList* moveList, int bestMove, Position& pos);
 
-        extern  int negamax(int alpha, int beta, int depth, bool cutnode, Position& pos);
+        template <NodeType nodeType>
+        int negamax(int alpha, int beta, int depth, bool cutnode, Position& pos);
 
         void search(Position& pos, int depth, bool ponder);
     }
@@ -15,8 +15,10 @@
 #include <sys/types.h>
 #endif 
 
+#include "time.h"
+#include "profile.h"
 
-
+namespace Sloth {
 
 	int Time::getTimeMs() {
 	#ifdef _WIN32
@@ -63,36 +65,70 @@
 	#endif
 	}
 
-	void Time::readInput() {
-		char input[256] = "";
+	/*
+		Lines read during a search that the search does not handle itself (position, setoption, go, ...).
+		They are kept in order in a fixed ring, so polling never allocates, and the UCI loop runs them once
+		the search has printed its bestmove.
+	*/
+	const int PENDING_INPUT_LINES = 16;
+	const int INPUT_LENGTH = 2000; // same as the UCI loop
 
-		if (inputWaiting()) {
-			stopped = true;
+	static char pendingInput[PENDING_INPUT_LINES][INPUT_LENGTH];
+	static int pendingFirst = 0, pendingCount = 0;
+
+	bool Time::nextInput(char* input, int size) {
+		if (pendingCount == 0) return false;
 
-			std::cin.getline(input, 256);
-			int bytes = std::cin.gcount();
+		snprintf(input, size, "%s", pendingInput[pendingFirst]);
+		pendingFirst = (pendingFirst + 1) % PENDING_INPUT_LINES;
+		pendingCount--;
 
-			if (bytes > 0) {
-				char* endc = strchr(input, '\n');
-				if (endc) *endc = 0;
+		return true;
+	}
+
+	/*
+		Commands that can arrive while a search is running. stop and quit end it, ponderhit turns a ponder search
+		into a normal timed one on the clock that go ponder set up, and isready is answered right away. Anything
+		else is queued for the UCI loop. EOF is ignored, so a search run with stdin closed (sloth bench </dev/null)
+		is not cut short.
+	*/
+	void Time::readInput() {
+		if (inputClosed || !inputWaiting()) return;
 
-				if (std::strncmp(input, "quit", 4) == 0) {
-					quit = true;
-				}
+		char input[INPUT_LENGTH] = "";
 
-				if (std::strncmp(input, "stop", 4) == 0) {
-					stopped = true;
-				}
+		if (!fgets(input, sizeof(input), stdin)) {
+			inputClosed = true;
+			return;
+		}
+
+		if (std::strncmp(input, "quit", 4) == 0) {
+			quit = true;
+			stopped = true;
+		} else if (std::strncmp(input, "stop", 4) == 0) {
+			stopped = true;
+		} else if (std::strncmp(input, "ponderhit", 9) == 0) {
+			ponder = false;
+		} else if (std::strncmp(input, "isready", 7) == 0) {
+			printf("readyok\n");
+		} else if (input[0] != '\n') {
+			if (pendingCount == PENDING_INPUT_LINES) {
+				printf("info string input queue full, dropped %s", input);
+				return;
 			}
+
+			memcpy(pendingInput[(pendingFirst + pendingCount) % PENDING_INPUT_LINES], input, sizeof(input));
+			pendingCount++;
 		}
 	}
 
 	void Time::communicate() {
+		PHASE_TIMER(Communicate);
+
 		if (timeSet == 1 && getTimeMs() > stopTime && !ponder) {
 			stopped = true;
 		}
 
 		readInput();
 	}
-
-
+}
@@ -25,6 +25,7 @@ namespace Sloth {
 		bool quit = false;
 		bool stopped = false;
 		bool ponder = true;
+		bool inputClosed = false; // stdin hit EOF, there is nothing left to poll
 
 		int movesToGo = 30;
 		int moveTime = -1;
@@ -39,6 +40,8 @@ namespace Sloth {
 		
 		void readInput();
 		void communicate();
+		bool nextInput(char* input, int size); // pops a line read during a search for the UCI loop
+
 	};
 }
 #endif
@@ -15,13 +15,18 @@
 
 #define VALUE_INFINITE 50000
 
-#define MAX_PLY 64
+// ply limit of the search, can be set at build time (-DMAX_PLY=N)
+#ifndef MAX_PLY
+#define MAX_PLY 246
+#endif
 
 #define NO_HASH_ENTRY 100000
 //#define MAX_HASH 256 // max hash 128 mb
 #define MIN_HASH 16
 #define MAX_HASH 1028
 
+#define MAX_MULTIPV 256
+
 #define hashfEXACT 0
 #define hashfALPHA 1
 #define hashfBETA 2
@@ -13,7 +13,10 @@
 #include "piece.h"
 #include "position.h"
 #include "search.h"
+#include "evaluate.h"
 #include "perft.h"
+#include "bench.h"
+#include "allocguard.h"
 
 #ifndef _WIN32
 #include <cstdio>
@@ -27,20 +30,6 @@ static int sscanf_s(const char *buffer, const char *format, ...) {       // for
     return result;
 }
 
-#include <cstring>
-#include <stdexcept>
-
-static void strcpy_s(char* dest, size_t destsz, const char* src) {        // for GCC/Clang - JA
-    if (dest == nullptr || src == nullptr) {
-        throw std::invalid_argument("Null pointer argument");
-    }
-    size_t src_len = std::strlen(src);
-    if (src_len >= destsz) {
-        throw std::length_error("Destination buffer too small");
-    }
-    std::strcpy(dest, src);
-}
-
 #endif
 
 namespace Sloth {
@@ -94,14 +83,12 @@ namespace Sloth {
     void UCI::parsePosition(Position& pos, const char* command) {
         command += 9;
 
-        char* cmdCpy = new char[strlen(command) + 1];
-        strcpy_s(cmdCpy, strlen(command) + 1, command);
-        char* curChar = cmdCpy;
+        const char* curChar = command;
 
         if (strncmp(command, "startpos", 8) == 0) {
             pos.parseFen(startPosition);
         } else {
-            curChar = strstr(cmdCpy, "fen");
+            curChar = strstr(command, "fen");
 
             if (curChar == NULL) {
                 pos.parseFen(startPosition);
@@ -111,7 +98,7 @@ namespace Sloth {
             }
         }
 
-        curChar = strstr(cmdCpy, "moves");
+        curChar = strstr(command, "moves");
 
         if (curChar != NULL) {
             curChar += 6;
@@ -122,6 +109,10 @@ namespace Sloth {
                 if (move == 0) break;
 
                 Search::repetitionIndex++;
+
+                if (Search::repetitionIndex >= static_cast<int>(Search::repetitionTable.size()))
+                    Search::repetitionTable.resize(Search::repetitionTable.size() * 2 + MAX_PLY);
+
                 Search::repetitionTable[Search::repetitionIndex] = pos.hashKey;
 
                 pos.makeMove(pos, move, MoveType::allMoves);
@@ -130,8 +121,6 @@ namespace Sloth {
                 curChar++;
             }
         }
-
-        delete[] cmdCpy;
     }
 
     void resetTimeControl(Position& pos) {
@@ -144,49 +133,80 @@ namespace Sloth {
         pos.time.stopTime = 0;
         pos.time.timeSet = 0;
         pos.time.stopped = 0;
+        pos.time.ponder = false;
     }
 
     void UCI::parseGo(Position& pos, const char* command) {
+        AllocGuard::beginGo();
         resetTimeControl(pos);
         bool ponder = false;
 
         int depth = -1;
         bool perft = false;
+        int perftThreads = 1;
+        int perftHash = 0;
+        bool perftBulk = false;
 
-        char* cmdCpy = new char[strlen(command) + 1];
-        strcpy_s(cmdCpy, strlen(command) + 1, command);
+        const char* argument = NULL;
 
-        char* argument = NULL;
+        if ((argument = strstr(command, "infinite"))) {}
 
-        if ((argument = strstr(cmdCpy, "infinite"))) {}
-
-        if ((argument = strstr(cmdCpy, "binc")) && pos.sideToMove == Colors::black)
+        if ((argument = strstr(command, "binc")) && pos.sideToMove == Colors::black)
             pos.time.inc = atoi(argument + 5);
 
-        if ((argument = strstr(cmdCpy, "winc")) && pos.sideToMove == Colors::white)
+        if ((argument = strstr(command, "winc")) && pos.sideToMove == Colors::white)
             pos.time.inc = atoi(argument + 5);
 
-        if ((argument = strstr(cmdCpy, "wtime")) && pos.sideToMove == Colors::white)
+        if ((argument = strstr(command, "wtime")) && pos.sideToMove == Colors::white)
             pos.time.time = atoi(argument + 6);
 
-        if ((argument = strstr(cmdCpy, "btime")) && pos.sideToMove == Colors::black)
+        if ((argument = strstr(command, "btime")) && pos.sideToMove == Colors::black)
             pos.time.time = atoi(argument + 6);
 
-        if ((argument = strstr(cmdCpy, "movestogo")))
+        if ((argument = strstr(command, "movestogo")))
             pos.time.movesToGo = atoi(argument + 10);
 
-        if ((argument = strstr(cmdCpy, "movetime")))
+        if ((argument = strstr(command, "movetime")))
             pos.time.moveTime = atoi(argument + 9);
 
-        if ((argument = strstr(cmdCpy, "depth")))
+        if ((argument = strstr(command, "depth")))
             depth = atoi(argument + 6);
 
-        if ((argument = strstr(cmdCpy, "perft"))) {
+        if ((argument = strstr(command, "perft"))) {
             depth = atoi(argument + 6);
             perft = true;
         }
+
+        if (perft && (argument = strstr(command, "threads")))
+            perftThreads = atoi(argument + 8);
+
+        if (perft && (argument = strstr(command, "hash")))
+            perftHash = atoi(argument + 5);
+
+        if (perft && strstr(command, "bulk"))
+            perftBulk = true;
         
-        if ((argument = strstr(cmdCpy, "ponder"))) {
+        Search::searchMoves.clear();
+
+        // searchmoves takes every move that follows it, up to the next token that is not a legal move
+        if (!perft && (argument = strstr(command, "searchmoves"))) {
+            argument += 11;
+
+            while (*argument == ' ') argument++;
+
+            while (*argument && *argument != '\n') {
+                int move = parseMove(pos, argument);
+
+                if (move == 0) break;
+
+                Search::searchMoves.push_back(move);
+
+                while (*argument && *argument != ' ' && *argument != '\n') argument++;
+                while (*argument == ' ') argument++;
+            }
+        }
+
+        if ((argument = strstr(command, "ponder"))) {
             ponder = true;
             pos.time.ponder = true;
         }
@@ -209,26 +229,20 @@ namespace Sloth {
                     pos.time.stopTime = pos.time.startTime + pos.time.inc - 50;
             }
 
-            if (depth == -1) {
-                depth = 64;
-            }
-
-            if (ponder) {
-                pos.time.time = 40000000;
-                pos.time.stopTime = 40000000;
-                pos.time.timeSet = 1;
-                depth = 64;
+            if (depth == -1 || depth > MAX_PLY) {
+                depth = MAX_PLY;
             }
 
+            // a ponder search keeps the time control above, it only starts to count once ponderhit arrives
             Search::search(pos, depth, ponder);
         } else {
             if (Bitboards::occupancies[Colors::both] == 0ULL)
                 parsePosition(game, "position startpos");
 
-            Perft::perftTest(depth, pos);
+            Perft::perftTest(depth, pos, perftThreads, perftHash, perftBulk);
         }
 
-        delete[] cmdCpy;
+        AllocGuard::endGo();
     }
 
     void UCI::loop() {
@@ -244,7 +258,8 @@ namespace Sloth {
             memset(input, 0, sizeof(input));
             fflush(stdout);
 
-            if (!fgets(input, 2000, stdin)) continue;
+            // lines that arrived during the last search come first, in the order they were sent
+            if (!game.time.nextInput(input, sizeof(input)) && !fgets(input, 2000, stdin)) break; // EOF
 
             if (input[0] == '\n') continue;
 
@@ -259,8 +274,19 @@ namespace Sloth {
                 Search::clearHashTable();
             } else if (strncmp(input, "go", 2) == 0) {
                 parseGo(game, input);
+
+                if (game.time.quit) break; // quit arrived during the search
+            } else if (strncmp(input, "bench", 5) == 0) {
+                int depth = atoi(input + 5);
+                Bench::run(depth > 0 ? depth : 10);
+            } else if (strncmp(input, "stats", 5) == 0) {
+                Search::printStats();
+            } else if (strncmp(input, "eval", 4) == 0) {
+                Eval::trace(game);
             } else if (strncmp(input, "stop", 4) == 0) {
                 game.time.stopped = true;
+            } else if (strncmp(input, "ponderhit", 9) == 0) {
+                game.time.ponder = false; // the search already finished, nothing left to convert
             }
             else if (strncmp(input, "quit", 4) == 0) {
                 break;
@@ -270,6 +296,9 @@ namespace Sloth {
                 printf("option name Hash type spin default 64 min %d max %d\n", MIN_HASH, MAX_HASH);
                 printf("option name Contempt type spin default 0 min 0 max 200\n");
                 printf("option name Ponder type check default false\n");
+                printf("option name IIRDepth type spin default 4 min 0 max 20\n");
+                printf("option name QSearchChecks type check default false\n");
+                printf("option name MultiPV type spin default 1 min 1 max %d\n", MAX_MULTIPV);
                 printf("uciok\n");
             } else if (!strncmp(input, "setoption name Hash value ", 26)) {
                 sscanf_s(input, "%*s %*s %*s %*s %d", &mbHash);
@@ -282,6 +311,20 @@ namespace Sloth {
                 if (contempt < 0) contempt = 0;
                 if (contempt > 200) contempt = 200;
                 Search::contempt = contempt;
+            } else if (!strncmp(input, "setoption name IIRDepth value ", 30)) {
+                int iirDepth;
+                sscanf_s(input, "%*s %*s %*s %*s %d", &iirDepth);
+                if (iirDepth < 0) iirDepth = 0;
+                if (iirDepth > 20) iirDepth = 20;
+                Search::iirDepth = iirDepth;
+            } else if (!strncmp(input, "setoption name MultiPV value ", 29)) {
+                int multiPV;
+                sscanf_s(input, "%*s %*s %*s %*s %d", &multiPV);
+                if (multiPV < 1) multiPV = 1;
+                if (multiPV > MAX_MULTIPV) multiPV = MAX_MULTIPV;
+                Search::multiPV = multiPV;
+            } else if (!strncmp(input, "setoption name QSearchChecks value ", 35)) {
+                Search::qsearchChecks = !strncmp(input + 35, "true", 4);
             }
         }
     }